@@ -0,0 +1,120 @@
+/* Batch benchmark - MatchingEngine::processBatch against one call per message
+A seeded OrderFlow is turned into journal records up front. For each batch
+size the same records go through a fresh engine once per message
+(processOrder / cancelOrder, the orders copied into the book pool as a
+gateway would) and in batches, first with no market data and then publishing
+to a ring in /tmp. One call per message publishes with setPublisher(pub, batch),
+so both diff the books equally often. Events are collected and cleared once
+per call. Each run is repeated RUNS times and the best is kept. Reports
+orders/s of both and the speedup of the batch. */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "../src/matchingEngine.h"
+#include "../src/orderFlow.h"
+using namespace std;
+using namespace Matching;
+
+#define RUNS 3
+
+typedef chrono::steady_clock Clock;
+
+struct Setup {
+	BookConfig config;
+	const char* ring; //NULL : no market data
+};
+
+//perMessage : one call per message, market data published every batch messages
+static double runOnce(const Setup& setup, const vector<LogRecord>& records, size_t batch, bool perMessage) {
+	MatchingEngine engine(setup.config);
+	EventBuffer events;
+	engine.setEventBuffer(&events);
+	MarketDataPublisher publisher;
+	if(setup.ring != NULL && publisher.open(setup.ring))
+		engine.setPublisher(&publisher, perMessage ? batch : 1);
+	OrderBook* book = engine.bookFor(DEFAULT_SYMBOL_ID);
+	Clock::time_point start = Clock::now();
+	if(perMessage) {
+		for(const LogRecord& record : records) {
+			if(record.type == LOG_CANCEL)
+				engine.cancelOrder(record.id);
+			else
+				engine.processOrder(book->newOrder(record.id, (TraderId)record.trader, record.price, record.quantity,
+					record.time, record.flags & ORDER_BUY));
+			events.clear();
+		}
+	}
+	else {
+		for(size_t i = 0; i < records.size(); i += batch) {
+			engine.processBatch(records.data() + i, min(batch, records.size() - i));
+			events.clear();
+		}
+	}
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double best(const Setup& setup, const vector<LogRecord>& records, size_t batch, bool perMessage) {
+	double seconds = runOnce(setup, records, batch, perMessage);
+	for(int i = 1; i < RUNS; ++i)
+		seconds = min(seconds, runOnce(setup, records, batch, perMessage));
+	return seconds;
+}
+
+void usage() {
+	printf("Usage: batch_bench [-n messages] [-s seed] [-c cancelRatio] [-d depth]\n");
+}
+
+int main(int argc, char** argv) {
+	FlowConfig flowConfig;
+	size_t nMessages = 1000000;
+	int opt;
+	while((opt = getopt(argc, argv, "n:s:c:d:")) != -1) {
+		switch(opt) {
+		case 'n': nMessages = atol(optarg); break;
+		case 's': flowConfig.seed = atoll(optarg); break;
+		case 'c': flowConfig.cancelRatio = atof(optarg); break;
+		case 'd': flowConfig.depth = atoi(optarg); break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+
+	OrderFlow generator(flowConfig);
+	vector<LogRecord> records(nMessages);
+	FlowMessage message;
+	for(size_t i = 0; i < nMessages; ++i) {
+		generator.next(message);
+		if(message.type == LOG_CANCEL) {
+			LogRecord cancel = { LOG_CANCEL, 0, DEFAULT_SYMBOL_ID, 0, message.order.id, 0, 0, 0 };
+			records[i] = cancel;
+		}
+		else
+			records[i] = newRecord(message.order);
+	}
+
+	int base = generator.minPrice() - 1, ticks = generator.maxPrice() - base + 2;
+	BookConfig config(PRICE_TIME, ARRAY_LADDER, base, ticks);
+	config.orderCapacity = 1 << 20;
+	string ring = "/tmp/matching_batch_bench_" + to_string(getpid());
+	Setup setups[] = { { config, NULL }, { config, ring.c_str() } };
+	const char* names[] = { "no market data", "market data" };
+
+	printf("%zu messages, seed %llu, best of %d\n", nMessages, (unsigned long long)flowConfig.seed, RUNS);
+	size_t sizes[] = { 1, 16, 64, 256, 1024 };
+	for(int s = 0; s < 2; ++s) {
+		printf("%s\n%-8s %14s %14s %8s\n", names[s], "batch", "per message/s", "batched/s", "speedup");
+		for(size_t batch : sizes) {
+			double single = best(setups[s], records, batch, true);
+			double seconds = best(setups[s], records, batch, false);
+			printf("%-8zu %14.0f %14.0f %8.2f\n", batch, nMessages / single, nMessages / seconds, single / seconds);
+		}
+	}
+	unlink(ring.c_str());
+	return 0;
+}
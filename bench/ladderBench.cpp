@@ -0,0 +1,75 @@
+/* Ladder benchmark - tree ladder against array ladder
+Times add() of resting orders and match() sweeps through several levels
+on books that only differ by their ladder type. */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../src/orderbook.h"
+using namespace std;
+using namespace Matching;
+
+#define MID 50000
+#define RANGE 1000
+#define NADD 1000000
+#define NSWEEP 200000
+#define SWEEP_LEVELS 5
+
+typedef chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point start, Clock::time_point end, int n) {
+	return chrono::duration<double, nano>(end - start).count() / n;
+}
+
+/*resting orders spread over RANGE ticks on each side of MID */
+static double benchAdd(const BookConfig& config) {
+	mt19937 rng(42);
+	uniform_int_distribution<int> offset(1, RANGE);
+	vector<Order*> orders;
+	orders.reserve(NADD);
+	for(int i = 0; i < NADD; ++i) {
+		bool isBuy = i & 1;
+		int price = isBuy ? MID - offset(rng) : MID + offset(rng);
+		orders.push_back(new Order(i, "bench", price, 100, i, isBuy));
+	}
+
+	OrderBook book(config);
+	Clock::time_point start = Clock::now();
+	for(Order* order : orders)
+		book.add(order);
+	return nsPerOp(start, Clock::now(), NADD);
+}
+
+/*each aggressive buy takes out SWEEP_LEVELS ask levels, which are
+posted again before the next one */
+static double benchSweep(const BookConfig& config) {
+	OrderBook book(config);
+	//some depth behind the swept levels
+	for(int i = 0; i < RANGE; ++i)
+		book.add(new Order(i, "bench", MID + SWEEP_LEVELS + 1 + i, 100, i, false));
+
+	int id = RANGE;
+	Clock::duration spent(0);
+	for(int i = 0; i < NSWEEP; ++i) {
+		for(int level = 1; level <= SWEEP_LEVELS; ++level, ++id)
+			book.add(new Order(id, "bench", MID + level, 100, id, false));
+		Order* order = new Order(id, "bench", MID + SWEEP_LEVELS, 100 * SWEEP_LEVELS, id, true);
+		++id;
+		int qtyToMatch = order->quantity;
+		Clock::time_point start = Clock::now();
+		book.match(order, qtyToMatch);
+		spent += Clock::now() - start;
+	}
+	return chrono::duration<double, nano>(spent).count() / NSWEEP;
+}
+
+int main() {
+	BookConfig tree(PRICE_TIME, TREE_LADDER);
+	BookConfig array(PRICE_TIME, ARRAY_LADDER, MID - 2 * RANGE, 4 * RANGE);
+
+	printf("%-8s %14s %14s\n", "ladder", "add ns/op", "sweep ns/op");
+	printf("%-8s %14.1f %14.1f\n", "tree", benchAdd(tree), benchSweep(tree));
+	printf("%-8s %14.1f %14.1f\n", "array", benchAdd(array), benchSweep(array));
+	return 0;
+}
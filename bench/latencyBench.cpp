@@ -0,0 +1,120 @@
+/* Latency benchmark - per message latency of MatchingEngine::processOrder
+A seeded OrderFlow is generated up front, then replayed through one engine
+per book implementation (ladder type and queue priority). Every message is
+timed on its own with steady_clock, the overhead of the two clock reads is
+measured first and taken off. Reports orders/s and p50/p99/p99.9/max in ns. */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+#include "../src/matchingEngine.h"
+#include "../src/orderFlow.h"
+#include "../src/histogram.h"
+using namespace std;
+using namespace Matching;
+
+typedef chrono::steady_clock Clock;
+
+static inline uint64_t nowNs() {
+	return chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+//cost of back to back clock reads, taken off every sample
+static uint64_t clockOverhead() {
+	LatencyHistogram h;
+	for(int i = 0; i < 100000; ++i) {
+		uint64_t start = nowNs();
+		h.record(nowNs() - start);
+	}
+	return h.percentile(50);
+}
+
+struct Candidate {
+	const char* name;
+	BookConfig config;
+};
+
+static void runOne(const Candidate& candidate, const vector<FlowMessage>& flow, size_t warmup, uint64_t overhead) {
+	MatchingEngine engine(candidate.config);
+	OrderBook* book = engine.bookFor(DEFAULT_SYMBOL_ID);
+	LatencyHistogram latency;
+
+	//the warmup part fills the book and the pools, it is not recorded
+	for(size_t i = 0; i < warmup && i < flow.size(); ++i) {
+		if(flow[i].type == LOG_NEW)
+			engine.processOrder(book->newOrder(flow[i].order));
+		else
+			engine.cancelOrder(flow[i].order.id);
+	}
+
+	uint64_t begin = nowNs();
+	for(size_t i = warmup; i < flow.size(); ++i) {
+		uint64_t start = nowNs();
+		if(flow[i].type == LOG_NEW)
+			engine.processOrder(book->newOrder(flow[i].order));
+		else
+			engine.cancelOrder(flow[i].order.id);
+		uint64_t spent = nowNs() - start;
+		latency.record(spent > overhead ? spent - overhead : 0);
+	}
+	double seconds = (nowNs() - begin) / 1e9;
+	size_t n = flow.size() > warmup ? flow.size() - warmup : 0;
+	printf("%-16s %12.0f %10llu %10llu %10llu %10llu\n", candidate.name, seconds > 0 ? n / seconds : 0.0,
+		(unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+		(unsigned long long)latency.percentile(99.9), (unsigned long long)latency.max());
+}
+
+void usage() {
+	printf("Usage: latency_bench [-n messages] [-w warmup] [-s seed] [-b buyRatio] [-m marketableRatio] [-c cancelRatio] [-d depth]\n");
+}
+
+int main(int argc, char** argv) {
+	FlowConfig flowConfig;
+	size_t nMessages = 2000000, warmup = 200000;
+	int opt;
+	while((opt = getopt(argc, argv, "n:w:s:b:m:c:d:")) != -1) {
+		switch(opt) {
+		case 'n': nMessages = atol(optarg); break;
+		case 'w': warmup = atol(optarg); break;
+		case 's': flowConfig.seed = atoll(optarg); break;
+		case 'b': flowConfig.buyRatio = atof(optarg); break;
+		case 'm': flowConfig.marketableRatio = atof(optarg); break;
+		case 'c': flowConfig.cancelRatio = atof(optarg); break;
+		case 'd': flowConfig.depth = atoi(optarg); break;
+		default:
+			usage();
+			return -1;
+		}
+	}
+
+	OrderFlow generator(flowConfig);
+	vector<FlowMessage> flow(nMessages);
+	for(size_t i = 0; i < nMessages; ++i)
+		generator.next(flow[i]);
+
+	int base = generator.minPrice() - 1, ticks = generator.maxPrice() - base + 2;
+	BookConfig reserved;
+	reserved.orderCapacity = 1 << 20;
+	reserved.levelCapacity = 4 * flowConfig.depth;
+	BookConfig arrayReserved(PRICE_TIME, ARRAY_LADDER, base, ticks);
+	arrayReserved.orderCapacity = reserved.orderCapacity;
+	arrayReserved.levelCapacity = reserved.levelCapacity;
+	Candidate candidates[] = {
+		{ "tree", BookConfig(PRICE_TIME, TREE_LADDER) },
+		{ "tree reserved", reserved },
+		{ "array", BookConfig(PRICE_TIME, ARRAY_LADDER, base, ticks) },
+		{ "array reserved", arrayReserved },
+		{ "tree size-time", BookConfig(SIZE_TIME, TREE_LADDER) },
+		{ "array size-time", BookConfig(SIZE_TIME, ARRAY_LADDER, base, ticks) }
+	};
+
+	uint64_t overhead = clockOverhead();
+	printf("%zu messages (%zu warmup), seed %llu, clock overhead %llu ns\n", nMessages, warmup,
+		(unsigned long long)flowConfig.seed, (unsigned long long)overhead);
+	printf("%-16s %12s %10s %10s %10s %10s\n", "book", "orders/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+	for(const Candidate& candidate : candidates)
+		runOne(candidate, flow, warmup, overhead);
+	return 0;
+}
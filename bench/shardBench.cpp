@@ -0,0 +1,77 @@
+/* Shard benchmark - throughput of the sharded engine from 1 to N worker threads
+The same order stream over NSYMBOLS instruments is replayed with one shard,
+two, ... up to the thread count given on the command line (default: the
+number of cores minus the dispatcher). */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/shardedEngine.h"
+using namespace std;
+using namespace Matching;
+
+#define NSYMBOLS 64
+#define NORDERS 2000000
+#define MID 10000
+#define RANGE 20
+
+typedef chrono::steady_clock Clock;
+
+//results are dropped, the merger still has to drain them
+struct DropSink {
+	void operator()(const ShardResult&) {}
+};
+
+/*random limit orders around MID, about half of them cross */
+static vector<Order> makeOrders() {
+	mt19937 rng(42);
+	uniform_int_distribution<int> offset(-RANGE, RANGE);
+	uniform_int_distribution<int> qty(1, 200);
+	vector<SymbolId> symbols;
+	for(int i = 0; i < NSYMBOLS; ++i)
+		symbols.push_back(symbolTable().intern("SYM" + to_string(i)));
+	TraderId trader = traderTable().intern("bench");
+
+	vector<Order> orders;
+	orders.reserve(NORDERS);
+	for(int i = 0; i < NORDERS; ++i)
+		orders.push_back(Order(i, trader, MID + offset(rng), qty(rng), i, rng() & 1, symbols[rng() % NSYMBOLS]));
+	return orders;
+}
+
+static double ordersPerSecond(const vector<Order>& orders, size_t nShards) {
+	BookConfig config(PRICE_TIME, ARRAY_LADDER, MID - 2 * RANGE, 4 * RANGE);
+	ShardedEngine engine(nShards, config);
+	DropSink sink;
+	Clock::time_point start = Clock::now();
+	engine.start();
+	for(size_t i = 0; i < orders.size(); ++i) {
+		engine.submit(LOG_NEW, orders[i]);
+		if((i & (SHARD_RING_SIZE - 1)) == 0)
+			engine.poll(sink);
+	}
+	engine.stop();
+	engine.poll(sink);
+	return orders.size() / chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	size_t maxShards = thread::hardware_concurrency() > 1 ? thread::hardware_concurrency() - 1 : 1;
+	if(argc > 1)
+		maxShards = atoi(argv[1]);
+	vector<Order> orders = makeOrders();
+
+	printf("%-8s %14s %10s\n", "shards", "orders/s", "speedup");
+	double base = 0;
+	for(size_t n = 1; n <= maxShards; ++n) {
+		double rate = ordersPerSecond(orders, n);
+		if(n == 1)
+			base = rate;
+		printf("%-8zu %14.0f %9.2fx\n", n, rate, rate / base);
+	}
+	return 0;
+}
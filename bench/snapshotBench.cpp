@@ -0,0 +1,54 @@
+/* Snapshot benchmark - save and restore time of a book of NORDERS resting orders
+Half bids below MID, half asks above it, over RANGE ticks each side, so
+nothing trades and every order is in the snapshot. */
+
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include "../src/matchingEngine.h"
+using namespace std;
+using namespace Matching;
+
+#define NORDERS 1000000
+#define MID 100000
+#define RANGE 1000
+#define SNAPSHOT_FILE "/tmp/matching_snapshot_bench.snp"
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+	BookConfig config(PRICE_TIME, ARRAY_LADDER, MID - RANGE, 2 * RANGE + 1);
+	TraderId trader = traderTable().intern("bench");
+	size_t resting = 0;
+	{
+		MatchingEngine engine(config);
+		OrderBook* book = engine.bookFor(DEFAULT_SYMBOL_ID);
+		book->reserve(NORDERS, 2 * RANGE);
+		for(int i = 0; i < NORDERS; ++i) {
+			bool isBuy = i & 1;
+			int offset = 1 + (i >> 1) % RANGE;
+			engine.processOrder(book->newOrder(i, trader, isBuy ? MID - offset : MID + offset, 100, i, isBuy));
+		}
+		Clock::time_point start = Clock::now();
+		if(!engine.saveSnapshot(SNAPSHOT_FILE))
+			return -1;
+		printf("save    %8.3f s\n", secondsSince(start));
+	}
+
+	MatchingEngine restored(config);
+	Clock::time_point start = Clock::now();
+	if(!restored.loadSnapshot(SNAPSHOT_FILE))
+		return -1;
+	double seconds = secondsSince(start);
+	const OrderBook* book = restored.getOrderBook();
+	for(const PriceLadder* ladder : { book->getBids(), book->getAsks() })
+		for(const PriceNode* level = ladder->best(); level != NULL; level = ladder->next(level->getPrice()))
+			resting += level->getQueue().size();
+	printf("restore %8.3f s, %zu resting orders\n", seconds, resting);
+	unlink(SNAPSHOT_FILE);
+	return 0;
+}
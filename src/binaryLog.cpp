@@ -0,0 +1,139 @@
+/* Implementation of the binary order log */
+
+#include <cstring>
+#include "binaryLog.h"
+#include "csvReader.h"
+
+namespace Matching {
+	static bool writeName(FILE* file, const string& name, size_t width) {
+		if(name.size() > width)
+			return false;
+		char buf[LOG_NAME_LEN] = {0};
+		memcpy(buf, name.data(), name.size());
+		return fwrite(buf, width, 1, file) == 1;
+	}
+
+	bool BinaryLogWriter::open(const string& path, const vector<string>& instruments, const vector<string>& traders) {
+		close();
+		file = fopen(path.c_str(), "wb");
+		if(file == NULL)
+			return false;
+		nRecords = 0;
+
+		LogHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+		header.version = LOG_VERSION;
+		header.instrumentCount = instruments.size();
+		header.traderCount = traders.size();
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		for(size_t i = 0; ok && i < instruments.size(); ++i)
+			ok = writeName(file, instruments[i], LOG_SYMBOL_LEN);
+		for(size_t i = 0; ok && i < traders.size(); ++i)
+			ok = writeName(file, traders[i], LOG_NAME_LEN);
+		if(!ok) {
+			fclose(file);
+			file = NULL;
+		}
+		return ok;
+	}
+
+	bool BinaryLogWriter::close() {
+		if(file == NULL)
+			return true;
+		bool ok = fseek(file, offsetof(LogHeader, recordCount), SEEK_SET) == 0 &&
+			fwrite(&nRecords, sizeof(nRecords), 1, file) == 1;
+		ok = fclose(file) == 0 && ok;
+		file = NULL;
+		return ok;
+	}
+
+	static string readName(const char* p, size_t width) {
+		return string(p, strnlen(p, width));
+	}
+
+	bool BinaryLogReader::open(const string& path) {
+		if(!file.open(path) || file.size() < sizeof(LogHeader))
+			return false;
+		header = reinterpret_cast<const LogHeader*>(file.begin());
+		if(memcmp(header->magic, LOG_MAGIC, sizeof(header->magic)) != 0 || header->version != LOG_VERSION)
+			return false;
+
+		//recordCount * sizeof(LogRecord) can wrap, the records are counted from the size
+		size_t tables = (size_t)header->instrumentCount * LOG_SYMBOL_LEN + (size_t)header->traderCount * LOG_NAME_LEN;
+		if(file.size() - sizeof(LogHeader) < tables)
+			return false;
+		size_t recordBytes = file.size() - sizeof(LogHeader) - tables;
+		if(recordBytes % sizeof(LogRecord) != 0 || header->recordCount != recordBytes / sizeof(LogRecord))
+			return false;
+
+		const char* p = file.begin() + sizeof(LogHeader);
+		instruments.clear();
+		traders.clear();
+		for(uint32_t i = 0; i < header->instrumentCount; ++i, p += LOG_SYMBOL_LEN)
+			instruments.push_back(readName(p, LOG_SYMBOL_LEN));
+		for(uint32_t i = 0; i < header->traderCount; ++i, p += LOG_NAME_LEN)
+			traders.push_back(readName(p, LOG_NAME_LEN));
+		records = reinterpret_cast<const LogRecord*>(p);
+		badRecords = 0;
+		return true;
+	}
+
+	bool BinaryLogReader::check(const LogRecord& record) {
+		if(record.type >= LOG_NEW && record.type <= LOG_REPLACE && record.instrument < header->instrumentCount &&
+			(record.type != LOG_NEW || record.trader < header->traderCount))
+			return true;
+		++badRecords;
+		fprintf(stderr, "Bad record %llu: type %u, trader %u, instrument %u\n", (unsigned long long)(&record - records),
+			(unsigned)record.type, (unsigned)record.trader, (unsigned)record.instrument);
+		return false;
+	}
+
+	int csvToBinary(const string& csvFile, const string& binFile, const string& symbol) {
+		CsvOrderReader reader;
+		if(!reader.open(csvFile)) {
+			fprintf(stderr, "Cannot open file at %s\n", csvFile.c_str());
+			return -1;
+		}
+		reader.setDefaultSymbol(symbolTable().intern(symbol));
+		vector<Order> orders;
+		Order order;
+		while(reader.next(order))
+			orders.push_back(order);
+
+		//the file tables only hold the traders and instruments of this
+		//file, records carry the index of their names in them
+		vector<string> traders, instruments;
+		vector<uint32_t> fileIndex(traderTable().size(), NO_ID);
+		vector<uint32_t> instrumentIndex(symbolTable().size(), NO_ID);
+		for(size_t i = 0; i < orders.size(); ++i) {
+			uint32_t& index = fileIndex[orders[i].trader];
+			if(index == NO_ID) {
+				index = traders.size();
+				traders.push_back(orders[i].name());
+			}
+			uint32_t& instrument = instrumentIndex[orders[i].symbol];
+			if(instrument == NO_ID) {
+				instrument = instruments.size();
+				instruments.push_back(symbolTable().name(orders[i].symbol));
+			}
+		}
+
+		BinaryLogWriter writer;
+		if(!writer.open(binFile, instruments, traders)) {
+			fprintf(stderr, "Cannot write %s (names are limited to %d chars, symbols to %d)\n",
+				binFile.c_str(), LOG_NAME_LEN, LOG_SYMBOL_LEN);
+			return -1;
+		}
+		for(size_t i = 0; i < orders.size(); ++i) {
+			LogRecord record = newRecord(orders[i], instrumentIndex[orders[i].symbol]);
+			record.trader = fileIndex[orders[i].trader];
+			writer.append(record);
+		}
+		if(!writer.close()) {
+			fprintf(stderr, "Cannot write %s\n", binFile.c_str());
+			return -1;
+		}
+		return orders.size();
+	}
+}
@@ -0,0 +1,143 @@
+/* Binary order log - compact fixed width order messages */
+/* Layout, little-endian throughout:
+	LogHeader                       32 bytes
+	instrument table                instrumentCount x LOG_SYMBOL_LEN bytes
+	trader table                    traderCount x LOG_NAME_LEN bytes
+	records                         recordCount x 32 bytes (LogRecord)
+Names are NUL padded. A record refers to its trader and instrument by their
+index in the tables, so a replay interns every name once when the file is
+opened and then hands each record to the engine without any parsing. */
+
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "order.h"
+#include "mappedFile.h"
+using namespace std;
+
+namespace Matching {
+	#define LOG_MAGIC "MATCHLOG"
+	#define LOG_VERSION 1
+	#define LOG_SYMBOL_LEN 16
+	#define LOG_NAME_LEN 32
+
+	#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+	#error "the binary order log is read and written in host order, which must be little-endian"
+	#endif
+
+	enum LogRecordType {
+		LOG_NEW = 1,
+		LOG_CANCEL = 2,
+		LOG_REPLACE = 3,
+		//journal only (see journal.h), names an id for the records after it
+		LOG_TRADER_NAME = 4,
+		LOG_SYMBOL_NAME = 5,
+		//journal only, the iceberg peak (quantity) of the LOG_NEW that follows
+		LOG_PEAK = 6,
+		//journal only, the LOG_NEW that follows is a stop triggered at price
+		LOG_STOP = 7,
+		//journal only, quantity 1 opens the call phase of the instrument, 0 uncrosses it
+		LOG_AUCTION = 8,
+		/*journal only, the pre-trade limits of trader in instrument. the next
+		record holds the RiskLimits (see orderbook.h) */
+		LOG_RISK_LIMITS = 9
+	};
+
+	//an input message, as opposed to the name and order attribute records
+	inline bool isMessage(uint8_t type) {
+		return (type >= LOG_NEW && type <= LOG_REPLACE) || type == LOG_AUCTION;
+	}
+
+	struct LogHeader {
+		char magic[8];
+		uint16_t version;
+		uint16_t reserved;
+		uint32_t instrumentCount;
+		uint32_t traderCount;
+		uint32_t reserved2;
+		uint64_t recordCount;
+	};
+
+	/*one input message. NEW uses every field, CANCEL only id,
+	REPLACE id, price and quantity */
+	struct LogRecord {
+		uint8_t type;
+		uint8_t flags; //Order::flags
+		uint16_t instrument;
+		uint32_t trader;
+		int64_t id;
+		int64_t time;
+		int32_t price;
+		int32_t quantity;
+	};
+
+	static_assert(sizeof(LogHeader) == 32, "LogHeader is 32 bytes on disk");
+	static_assert(sizeof(LogRecord) == 32, "LogRecord is 32 bytes on disk");
+
+	inline LogRecord newRecord(const Order& order, uint16_t instrument = 0) {
+		LogRecord r = { LOG_NEW, (uint8_t)order.flags, instrument, order.trader,
+			order.id, order.time, order.price, order.quantity };
+		return r;
+	}
+
+	class BinaryLogWriter {
+	private:
+		FILE* file;
+		uint64_t nRecords;
+
+		BinaryLogWriter(const BinaryLogWriter&);
+		BinaryLogWriter& operator=(const BinaryLogWriter&);
+	public:
+		BinaryLogWriter() : file(NULL), nRecords(0) {}
+		~BinaryLogWriter() { close(); }
+
+		//writes the header and both tables. false if a name does not fit
+		bool open(const string& path, const vector<string>& instruments, const vector<string>& traders);
+		bool append(const LogRecord& record) {
+			++nRecords;
+			return fwrite(&record, sizeof(record), 1, file) == 1;
+		}
+		//patches the record count into the header
+		bool close();
+	};
+
+	class BinaryLogReader {
+	private:
+		MappedFile file;
+		const LogHeader* header;
+		const LogRecord* records;
+		vector<string> instruments;
+		vector<string> traders;
+		size_t badRecords;
+
+	public:
+		BinaryLogReader() : header(NULL), records(NULL), badRecords(0) {}
+
+		//maps the file and checks its header and size
+		bool open(const string& path);
+
+		uint64_t size() const { return header->recordCount; }
+		const LogRecord* begin() const { return records; }
+		const LogRecord* end() const { return records + header->recordCount; }
+		size_t getBytes() const { return file.size(); }
+
+		const vector<string>& getInstruments() const { return instruments; }
+		const vector<string>& getTraders() const { return traders; }
+
+		/*false for a record of another type or whose trader or instrument
+		index is outside the tables, reported on stderr with its index like
+		a bad CSV line. callers skip it */
+		bool check(const LogRecord& record);
+		size_t getBadRecords() const { return badRecords; }
+	};
+
+	/*converts a CSV order file. orders without a SYMBOL column go to the
+	instrument named symbol */
+	int csvToBinary(const string& csvFile, const string& binFile, const string& symbol);
+}
+
+#endif /*BINARYLOG_H*/
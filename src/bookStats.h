@@ -0,0 +1,92 @@
+/* BookStats - hot path counters and latency histograms of one book */
+/* Only built with -DMATCHING_STATS (make STATS=1). Without it BookStats does
+not exist, OrderBook has no stats member and every BOOK_STATS(...) statement
+compiles to nothing, so a normal build pays nothing at all.
+
+A book is only ever touched by one thread (the engine thread or its shard
+worker), so its stats are per thread by construction. They are cache line
+aligned so the stats of books owned by different shards never share a line. */
+
+#ifndef BOOKSTATS_H
+#define BOOKSTATS_H
+
+#ifdef MATCHING_STATS
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include "histogram.h"
+#include "spscQueue.h"
+
+namespace Matching {
+	#define BOOK_STATS(...) __VA_ARGS__
+
+	inline uint64_t statsNow() {
+		return chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct alignas(CACHE_LINE) BookStats {
+		uint64_t orders; //match calls, one per incoming order
+		uint64_t cancels;
+		uint64_t amends; //reduce and replace
+		uint64_t fills;
+		uint64_t selfTrades; //fills self-trade prevention stopped
+		uint64_t levelsSwept;
+		uint64_t levelsCreated;
+		uint64_t levelsDestroyed;
+		uint64_t maxQueueDepth;
+		//ns, whole add / match / cancel calls
+		LatencyHistogram addLatency;
+		LatencyHistogram matchLatency;
+		LatencyHistogram cancelLatency;
+
+		BookStats() { clear(); }
+
+		void clear() {
+			orders = cancels = amends = fills = selfTrades = 0;
+			levelsSwept = levelsCreated = levelsDestroyed = maxQueueDepth = 0;
+			addLatency.clear();
+			matchLatency.clear();
+			cancelLatency.clear();
+		}
+
+		void merge(const BookStats& other) {
+			orders += other.orders;
+			cancels += other.cancels;
+			amends += other.amends;
+			fills += other.fills;
+			selfTrades += other.selfTrades;
+			levelsSwept += other.levelsSwept;
+			levelsCreated += other.levelsCreated;
+			levelsDestroyed += other.levelsDestroyed;
+			if(other.maxQueueDepth > maxQueueDepth)
+				maxQueueDepth = other.maxQueueDepth;
+			addLatency.merge(other.addLatency);
+			matchLatency.merge(other.matchLatency);
+			cancelLatency.merge(other.cancelLatency);
+		}
+
+		void print(FILE* out, const char* name) const {
+			fprintf(out, "%s: %llu messages (%llu orders, %llu cancels, %llu amends), %llu fills, %llu self-trades prevented\n", name,
+				(unsigned long long)(orders + cancels + amends), (unsigned long long)orders,
+				(unsigned long long)cancels, (unsigned long long)amends, (unsigned long long)fills,
+				(unsigned long long)selfTrades);
+			fprintf(out, "  levels swept %llu, created %llu, destroyed %llu, max queue depth %llu\n",
+				(unsigned long long)levelsSwept, (unsigned long long)levelsCreated,
+				(unsigned long long)levelsDestroyed, (unsigned long long)maxQueueDepth);
+			LatencyHistogram::printHeader(out, "ns");
+			addLatency.print(out, "add");
+			matchLatency.print(out, "match");
+			cancelLatency.print(out, "cancel");
+		}
+	};
+}
+
+#else
+
+#define BOOK_STATS(...)
+
+#endif /*MATCHING_STATS*/
+
+#endif /*BOOKSTATS_H*/
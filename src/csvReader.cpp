@@ -0,0 +1,133 @@
+/* Implementation of the memory mapped CSV order reader */
+
+#include <cstdio>
+#include <cstring>
+#include "csvReader.h"
+
+namespace Matching {
+	bool parseInt(string_view field, int64_t& value) {
+		size_t i = 0;
+		bool negative = false;
+		if(i < field.size() && (field[i] == '-' || field[i] == '+'))
+			negative = field[i++] == '-';
+		if(i == field.size() || field.size() - i > 18)
+			return false;
+		int64_t v = 0;
+		for(; i < field.size(); ++i) {
+			unsigned digit = field[i] - '0';
+			if(digit > 9)
+				return false;
+			v = v * 10 + digit;
+		}
+		value = negative ? -v : v;
+		return true;
+	}
+
+	bool parsePrice(string_view field, int& price) {
+		//prices are never negative. checked on the field, -0.50 has no sign left in its units
+		if(!field.empty() && field[0] == '-')
+			return false;
+		size_t point = field.find('.');
+		int64_t units = 0, fraction = 0;
+		if(!parseInt(field.substr(0, point), units))
+			return false;
+		if(point != string_view::npos) {
+			string_view decimals = field.substr(point + 1);
+			if(decimals.empty() || decimals.size() > PRICE_DECIMALS)
+				return false;
+			for(size_t i = 0; i < PRICE_DECIMALS; ++i) {
+				unsigned digit = i < decimals.size() ? decimals[i] - '0' : 0;
+				if(digit > 9)
+					return false;
+				fraction = fraction * 10 + digit;
+			}
+		}
+		int64_t ticks = units * PRICE_SCALE + fraction;
+		if(ticks > 0x7FFFFFFF)
+			return false;
+		price = ticks;
+		return true;
+	}
+
+	bool CsvOrderReader::open(const string& path) {
+		if(!file.open(path))
+			return false;
+		pos = file.begin();
+		lineNo = 0;
+		badLines = 0;
+		return true;
+	}
+
+	bool CsvOrderReader::parseLine(string_view line, Order& order) const {
+		string_view fields[NCOL_TYPE];
+		size_t nFields = 0;
+		size_t start = 0;
+		for(size_t i = 0; i <= line.size(); ++i) {
+			if(i == line.size() || line[i] == ',') {
+				if(nFields == NCOL_TYPE)
+					return false;
+				fields[nFields++] = line.substr(start, i - start);
+				start = i + 1;
+			}
+		}
+		if(nFields < NCOL || fields[1].empty())
+			return false;
+		if(nFields >= NCOL_SYMBOL && fields[6].empty())
+			return false;
+		uint16_t type = 0;
+		if(nFields == NCOL_TYPE) {
+			if(fields[7] == IOCSTR)
+				type = ORDER_IOC;
+			else if(fields[7] == FOKSTR)
+				type = ORDER_FOK;
+			else if(fields[7] == MARKETSTR)
+				type = ORDER_MARKET;
+			else if(fields[7] != LIMITSTR)
+				return false;
+		}
+
+		int64_t id, quantity, time;
+		int price;
+		if(!parseInt(fields[0], id) || !parsePrice(fields[2], price) ||
+			!parseInt(fields[3], quantity) || !parseInt(fields[4], time))
+			return false;
+		if(quantity <= 0 || quantity > 0x7FFFFFFF)
+			return false;
+		bool isBuy = fields[5] == BUYSTR;
+		if(!isBuy && fields[5] != SELLSTR)
+			return false;
+
+		SymbolId symbol = defaultSymbol;
+		if(nFields >= NCOL_SYMBOL) {
+			uint32_t interned = symbolTable().intern(fields[6]);
+			if(interned > 0xFFFF)
+				return false;
+			symbol = interned;
+		}
+		order = Order(id, traderTable().intern(fields[1]), price, quantity, time, isBuy, symbol);
+		order.flags |= type;
+		return true;
+	}
+
+	bool CsvOrderReader::next(Order& order) {
+		const char* end = file.end();
+		while(pos != NULL && pos < end) {
+			const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+			if(eol == NULL)
+				eol = end;
+			string_view line(pos, eol - pos);
+			pos = eol < end ? eol + 1 : end;
+			++lineNo;
+
+			if(!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			if(line.empty())
+				continue;
+			if(parseLine(line, order))
+				return true;
+			++badLines;
+			fprintf(stderr, "Bad line %zu: %.*s\n", lineNo, (int)line.size(), line.data());
+		}
+		return false;
+	}
+}
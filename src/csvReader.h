@@ -0,0 +1,63 @@
+/* CsvOrderReader - streaming order loader over a memory mapped file */
+/* The whole input is mapped read-only and parsed in place: fields are
+string_views into the mapping, numbers go through hand-rolled integer and
+fixed-point decimal parsers, and trader names are interned straight from
+the mapping. A line that does not parse is reported with its line number
+and skipped, it never reaches the book. */
+
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "order.h"
+#include "mappedFile.h"
+using namespace std;
+
+namespace Matching {
+	#define BUYSTR "BUY"
+	#define SELLSTR "SELL"
+	#define LIMITSTR "LIMIT"
+	#define IOCSTR "IOC"
+	#define FOKSTR "FOK"
+	#define MARKETSTR "MARKET"
+	#define NCOL 6
+	#define NCOL_SYMBOL 7
+	#define NCOL_TYPE 8
+
+	/*Order line is ID,NAME,PRICE,QUANTITY,TIME,BUY/SELL[,SYMBOL[,TYPE]]
+	price is a decimal with at most PRICE_DECIMALS digits after the point.
+	lines without a SYMBOL go to the reader's default symbol. TYPE is
+	LIMIT (the default), IOC, FOK or MARKET */
+	class CsvOrderReader {
+	private:
+		MappedFile file;
+		const char* pos;
+		size_t lineNo;
+		size_t badLines;
+		SymbolId defaultSymbol;
+
+		bool parseLine(string_view line, Order& order) const;
+
+	public:
+		CsvOrderReader() : pos(NULL), lineNo(0), badLines(0), defaultSymbol(DEFAULT_SYMBOL_ID) {}
+
+		bool open(const string& path);
+		//next good order of the file, false at the end of the file
+		bool next(Order& order);
+
+		void setDefaultSymbol(SymbolId symbol) { defaultSymbol = symbol; }
+
+		size_t getBytes() const { return file.size(); }
+		size_t getLineNumber() const { return lineNo; }
+		size_t getBadLines() const { return badLines; }
+	};
+
+	//field parsers, false if the field is not entirely a number
+	bool parseInt(string_view field, int64_t& value);
+	//a non negative price with up to PRICE_DECIMALS decimals, in ticks
+	bool parsePrice(string_view field, int& price);
+}
+
+#endif /*CSVREADER_H*/
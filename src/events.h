@@ -0,0 +1,124 @@
+/* Execution events - what the book did with each order */
+/* The book appends events to an EventBuffer the caller hands it. The buffer
+is a plain array reserved up front, so emitting is a bounds check and a
+copy: no allocation once the buffer has grown to its working size and no
+virtual call. The caller reads the events of an input message and clears
+the buffer before the next one. */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "order.h"
+using namespace std;
+
+namespace Matching {
+	enum EventType {
+		EVENT_ACCEPTED = 1, //an incoming order starts matching
+		EVENT_TRADE = 2, //one fill between the incoming order and a resting one
+		EVENT_PARTIAL_FILL = 3, //an order traded and still has leaves
+		EVENT_RESTED = 4, //the leaves were posted in the book
+		EVENT_DONE = 5, //the order left the engine, see DoneReason
+		EVENT_REJECTED = 6, //the pre-trade risk check refused the order, see RejectReason
+		EVENT_DECREMENTED = 7 //self-trade prevention took quantity off an order that stays open
+	};
+
+	enum DoneReason {
+		DONE_FILLED = 1,
+		DONE_CANCELLED = 2,
+		DONE_DROPPED = 3, //the price is outside the ladder range
+		DONE_EXPIRED = 4, //IOC, FOK or market leaves that were not allowed to rest
+		DONE_SELF_TRADE = 5 //cancelled or decremented away by self-trade prevention, see StpMode
+	};
+
+	//the limit a rejected order broke, see RiskLimits
+	enum RejectReason {
+		REJECT_ORDER_QTY = 1,
+		REJECT_OPEN_QTY = 2,
+		REJECT_POSITION = 3,
+		REJECT_NOTIONAL = 4,
+		REJECT_COLLAR = 5 //priced too far through the opposite best
+	};
+
+	/*id, trader and flags are the order the event is about. for a TRADE
+	that is the aggressor, the contra fields are the resting order and price
+	is the price of its level */
+	struct ExecEvent {
+		uint8_t type;
+		uint8_t reason; //DONE : DoneReason, REJECTED : RejectReason
+		uint16_t flags; //Order::flags
+		SymbolId symbol;
+		TraderId trader;
+		TraderId contraTrader;
+		OrderId id;
+		OrderId contraId;
+		int price;
+		int quantity; //TRADE : executed, DECREMENTED : taken off, otherwise the order quantity
+		int leaves; //quantity still open after the event
+	};
+
+	class EventBuffer {
+	private:
+		ExecEvent* events;
+		size_t n;
+		size_t cap;
+
+		EventBuffer(const EventBuffer&);
+		EventBuffer& operator=(const EventBuffer&);
+
+		void grow() {
+			size_t newCap = cap ? cap * 2 : 64;
+			ExecEvent* bigger = new ExecEvent[newCap];
+			if(n > 0)
+				memcpy(bigger, events, n * sizeof(ExecEvent));
+			delete[] events;
+			events = bigger;
+			cap = newCap;
+		}
+
+	public:
+		//capacity events fit without growing, a large sweep doubles it
+		EventBuffer(size_t capacity = 1024) : events(NULL), n(0), cap(0) {
+			if(capacity > 0) {
+				events = new ExecEvent[capacity];
+				cap = capacity;
+			}
+		}
+		~EventBuffer() { delete[] events; }
+
+		ExecEvent& push() {
+			if(n == cap)
+				grow();
+			return events[n++];
+		}
+		void clear() { n = 0; }
+
+		size_t size() const { return n; }
+		size_t capacity() const { return cap; }
+		bool empty() const { return n == 0; }
+		const ExecEvent& operator[](size_t i) const { return events[i]; }
+		const ExecEvent* begin() const { return events; }
+		const ExecEvent* end() const { return events + n; }
+	};
+
+	//an event about order, the contra fields left empty
+	inline void emitEvent(EventBuffer* buffer, EventType type, const Order* order, int quantity, int leaves,
+		int reason = 0) {
+		ExecEvent& e = buffer->push();
+		e.type = type;
+		e.reason = reason;
+		e.flags = order->flags;
+		e.symbol = order->symbol;
+		e.trader = order->trader;
+		e.contraTrader = 0;
+		e.id = order->id;
+		e.contraId = 0;
+		e.price = order->price;
+		e.quantity = quantity;
+		e.leaves = leaves;
+	}
+}
+
+#endif /*EVENTS_H*/
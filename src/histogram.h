@@ -0,0 +1,96 @@
+/* LatencyHistogram - fixed size log-linear (HDR style) histogram */
+/* Values below HIST_SUB get a bucket each, above that every power of two
+is split in HIST_SUB linear sub-buckets, so any value is known within
+1/HIST_SUB (about 3%) from 0 to 2^64. record() is a clz, a shift and an
+increment into a flat array that never allocates. */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+namespace Matching {
+	#define HIST_SUB_BITS 5
+	#define HIST_SUB (1 << HIST_SUB_BITS)
+	#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+	class LatencyHistogram {
+	private:
+		uint64_t counts[HIST_BUCKETS];
+		uint64_t total;
+		uint64_t maxValue;
+
+		static size_t indexOf(uint64_t v) {
+			if(v < HIST_SUB)
+				return v;
+			unsigned shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+			return (shift + 1) * HIST_SUB + (size_t)((v >> shift) - HIST_SUB);
+		}
+		//largest value that falls in bucket i
+		static uint64_t highestOf(size_t i) {
+			if(i < HIST_SUB)
+				return i;
+			size_t shift = i / HIST_SUB - 1;
+			uint64_t low = (uint64_t)(HIST_SUB + i % HIST_SUB) << shift;
+			return low + ((uint64_t)1 << shift) - 1;
+		}
+
+	public:
+		LatencyHistogram() { clear(); }
+
+		void record(uint64_t value) {
+			++counts[indexOf(value)];
+			++total;
+			if(value > maxValue)
+				maxValue = value;
+		}
+		void clear() {
+			memset(counts, 0, sizeof(counts));
+			total = 0;
+			maxValue = 0;
+		}
+		void merge(const LatencyHistogram& other) {
+			for(size_t i = 0; i < HIST_BUCKETS; ++i)
+				counts[i] += other.counts[i];
+			total += other.total;
+			if(other.maxValue > maxValue)
+				maxValue = other.maxValue;
+		}
+
+		uint64_t count() const { return total; }
+		uint64_t max() const { return maxValue; }
+		//smallest bucket bound that covers pct percent of the values
+		uint64_t percentile(double pct) const {
+			if(total == 0)
+				return 0;
+			uint64_t rank = (uint64_t)(pct / 100.0 * total + 0.5);
+			if(rank == 0)
+				rank = 1;
+			uint64_t seen = 0;
+			for(size_t i = 0; i < HIST_BUCKETS; ++i) {
+				seen += counts[i];
+				if(seen >= rank)
+					return highestOf(i) < maxValue ? highestOf(i) : maxValue;
+			}
+			return maxValue;
+		}
+
+		//one line: count p50 p99 p99.9 max
+		void print(FILE* out, const char* name) const {
+			fprintf(out, "%-16s %12llu %10llu %10llu %10llu %10llu\n", name,
+				(unsigned long long)total, (unsigned long long)percentile(50),
+				(unsigned long long)percentile(99), (unsigned long long)percentile(99.9),
+				(unsigned long long)maxValue);
+		}
+		static void printHeader(FILE* out, const char* unit) {
+			fprintf(out, "%-16s %12s %8s%2s %8s%2s %8s%2s %8s%2s\n", "", "count",
+				"p50", unit, "p99", unit, "p99.9", unit, "max", unit);
+		}
+	};
+}
+
+#endif /*HISTOGRAM_H*/
@@ -0,0 +1,72 @@
+/* Interner - dense ids for trader and symbol names */
+/* Names are hashed once, when they enter the engine. From then on a trader
+is a 32-bit id that indexes plain vectors, so nothing on the fill path
+hashes or compares strings. */
+
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+using namespace std;
+
+namespace Matching {
+	#define NO_ID 0xFFFFFFFFu
+
+	/*the keys view into names, a deque never moves its strings, so a
+	lookup from a string_view (straight out of an input buffer) does not
+	build a string */
+	class Interner {
+	private:
+		unordered_map<string_view, uint32_t> ids;
+		deque<string> names;
+
+		Interner(const Interner&);
+		Interner& operator=(const Interner&);
+	public:
+		Interner() {}
+
+		//id of name, a new one if it was never seen
+		uint32_t intern(string_view name) {
+			unordered_map<string_view, uint32_t>::iterator it = ids.find(name);
+			if(it != ids.end())
+				return it->second;
+			uint32_t id = names.size();
+			names.emplace_back(name);
+			ids.emplace(string_view(names.back()), id);
+			return id;
+		}
+
+		//id of name, NO_ID if it was never interned
+		uint32_t find(string_view name) const {
+			unordered_map<string_view, uint32_t>::const_iterator it = ids.find(name);
+			return it != ids.end() ? it->second : NO_ID;
+		}
+
+		const string& name(uint32_t id) const { return names[id]; }
+		size_t size() const { return names.size(); }
+	};
+
+	//process wide trader table, shared by every book
+	inline Interner& traderTable() {
+		static Interner table;
+		return table;
+	}
+
+	//instrument names. DEFAULT_SYMBOL is always id 0, the book of
+	//orders that do not name an instrument
+	#define DEFAULT_SYMBOL "DEFAULT"
+	#define DEFAULT_SYMBOL_ID 0
+
+	inline Interner& symbolTable() {
+		static Interner table;
+		if(table.size() == 0)
+			table.intern(DEFAULT_SYMBOL);
+		return table;
+	}
+}
+
+#endif /*INTERNER_H*/
@@ -0,0 +1,208 @@
+/* Implementation of the write-ahead journal */
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "journal.h"
+
+namespace Matching {
+	static bool writeAll(int fd, const char* p, size_t n) {
+		while(n > 0) {
+			ssize_t done = ::write(fd, p, n);
+			if(done < 0)
+				return false;
+			p += done;
+			n -= done;
+		}
+		return true;
+	}
+
+	bool Journal::open(const string& path, const JournalConfig& config_) {
+		close();
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+			return false;
+		config = config_;
+		if(config.batchRecords == 0)
+			config.batchRecords = 1;
+		JournalHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+		header.version = JOURNAL_VERSION;
+		if(!writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header))) {
+			::close(fd);
+			fd = -1;
+			return false;
+		}
+
+		ring = new SpscQueue<LogRecord>(config.ringSize);
+		appended = 0;
+		durable = 0;
+		failed = false;
+		knownTraders.clear();
+		knownSymbols.clear();
+		running = true;
+		writer = thread(&Journal::work, this);
+		return true;
+	}
+
+	bool Journal::close() {
+		if(fd < 0)
+			return true;
+		running.store(false, memory_order_release);
+		writer.join();
+		bool ok = !failed && ::close(fd) == 0;
+		fd = -1;
+		delete ring;
+		ring = NULL;
+		return ok;
+	}
+
+	void Journal::push(const LogRecord& record) {
+		//only a full ring makes the matching thread wait, never the disk
+		SpinWait wait;
+		while(!ring->push(record))
+			wait();
+	}
+
+	void Journal::pushData(const char* data, size_t bytes) {
+		for(size_t at = 0; at < bytes; at += sizeof(LogRecord)) {
+			LogRecord chunk;
+			memset(&chunk, 0, sizeof(chunk));
+			memcpy(&chunk, data + at, min(sizeof(LogRecord), bytes - at));
+			push(chunk);
+		}
+	}
+
+	void Journal::pushName(uint8_t type, uint32_t id, const string& name) {
+		LogRecord record;
+		memset(&record, 0, sizeof(record));
+		record.type = type;
+		record.flags = name.size() > 255 ? 255 : name.size();
+		record.trader = id;
+		push(record);
+		pushData(name.data(), record.flags);
+	}
+
+	void Journal::append(const LogRecord& record, const void* data, size_t bytes) {
+		append(record);
+		pushData(static_cast<const char*>(data), bytes);
+	}
+
+	void Journal::append(const LogRecord& record) {
+		if(record.type == LOG_NEW || record.type == LOG_RISK_LIMITS) {
+			if(record.trader >= knownTraders.size())
+				knownTraders.resize(record.trader + 1, false);
+			if(!knownTraders[record.trader]) {
+				knownTraders[record.trader] = true;
+				pushName(LOG_TRADER_NAME, record.trader, traderTable().name(record.trader));
+			}
+		}
+		if(record.instrument >= knownSymbols.size())
+			knownSymbols.resize(record.instrument + 1, false);
+		if(!knownSymbols[record.instrument]) {
+			knownSymbols[record.instrument] = true;
+			pushName(LOG_SYMBOL_NAME, record.instrument, symbolTable().name(record.instrument));
+		}
+		push(record);
+		appended += isMessage(record.type);
+	}
+
+	bool Journal::commit(const vector<LogRecord>& batch) {
+		if(!writeAll(fd, reinterpret_cast<const char*>(batch.data()), batch.size() * sizeof(LogRecord)))
+			return false;
+		return !config.sync || fdatasync(fd) == 0;
+	}
+
+	void Journal::work() {
+		typedef chrono::steady_clock Clock;
+		vector<LogRecord> batch;
+		batch.reserve(config.batchRecords + 16);
+		uint64_t messages = 0;
+		Clock::time_point oldest;
+		chrono::microseconds window(config.windowUs);
+		SpinWait idle;
+		while(true) {
+			bool stopping = !running.load(memory_order_acquire);
+			LogRecord record;
+			bool got = false;
+			while(batch.size() < config.batchRecords && ring->pop(record)) {
+				if(batch.empty())
+					oldest = Clock::now();
+				batch.push_back(record);
+				messages += isMessage(record.type);
+				got = true;
+			}
+			//name records are never split from their chunks by a stop, the
+			//ring only empties between two appends
+			bool drained = stopping && ring->empty();
+			if(!batch.empty() && (batch.size() >= config.batchRecords || drained ||
+				Clock::now() - oldest >= window)) {
+				//after a failed commit nothing more is durable, the
+				//batches behind it are dropped
+				if(!failed && commit(batch))
+					durable.fetch_add(messages, memory_order_release);
+				else
+					failed.store(true, memory_order_release);
+				batch.clear();
+				messages = 0;
+			}
+			if(drained && batch.empty())
+				break;
+			if(got)
+				idle.reset();
+			else
+				idle();
+		}
+	}
+
+	bool JournalReader::open(const string& path) {
+		if(!file.open(path) || file.size() < sizeof(JournalHeader))
+			return false;
+		const JournalHeader* header = reinterpret_cast<const JournalHeader*>(file.begin());
+		if(memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) != 0 || header->version != JOURNAL_VERSION)
+			return false;
+		pos = reinterpret_cast<const LogRecord*>(file.begin()) + 1;
+		//a torn last record is dropped
+		end = reinterpret_cast<const LogRecord*>(file.begin()) + file.size() / sizeof(LogRecord);
+		traders.clear();
+		symbols.clear();
+		return true;
+	}
+
+	bool JournalReader::next(LogRecord& record) {
+		while(pos < end) {
+			const LogRecord& r = *pos++;
+			if(r.type == LOG_TRADER_NAME || r.type == LOG_SYMBOL_NAME) {
+				size_t chunks = (r.flags + sizeof(LogRecord) - 1) / sizeof(LogRecord);
+				if((size_t)(end - pos) < chunks)
+					return false;
+				string_view name(reinterpret_cast<const char*>(pos), r.flags);
+				pos += chunks;
+				if(r.type == LOG_TRADER_NAME) {
+					if(r.trader >= traders.size())
+						traders.resize(r.trader + 1, 0);
+					traders[r.trader] = traderTable().intern(name);
+				}
+				else {
+					if(r.trader >= symbols.size())
+						symbols.resize(r.trader + 1, DEFAULT_SYMBOL_ID);
+					symbols[r.trader] = symbolTable().intern(name);
+				}
+				continue;
+			}
+			if(r.type == LOG_RISK_LIMITS) {
+				if(pos == end)
+					return false;
+				data = *pos++;
+			}
+			record = r;
+			if(record.type == LOG_NEW || record.type == LOG_RISK_LIMITS)
+				record.trader = record.trader < traders.size() ? traders[record.trader] : 0;
+			record.instrument = record.instrument < symbols.size() ? symbols[record.instrument] : DEFAULT_SYMBOL_ID;
+			return true;
+		}
+		return false;
+	}
+}
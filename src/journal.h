@@ -0,0 +1,119 @@
+/* Journal - write-ahead log of the input messages with group commit */
+/* The matching thread appends each accepted message as a LogRecord into a
+lock-free ring and goes on matching. A dedicated I/O thread drains the ring,
+writes the records and commits them with one fdatasync per batch: when
+batchRecords records are pending or the oldest pending one has waited
+windowUs, whichever comes first. getDurable() is the number of messages
+known to be on disk, a caller that must not acknowledge before the message
+is durable holds its acks until then.
+
+Layout, little-endian throughout:
+	JournalHeader                   32 bytes
+	records                         32 bytes each (LogRecord)
+Records carry the process trader and symbol ids. The first use of an id is
+preceded by a LOG_TRADER_NAME / LOG_SYMBOL_NAME record (trader = the id,
+flags = name length) followed by the name padded to whole records, so the
+journal needs no table up front. A LOG_RISK_LIMITS record is followed by one
+record of data the same way. A torn record at the end of the file, from
+a crash in the middle of a write, is ignored by recovery. */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binaryLog.h"
+#include "spscQueue.h"
+
+namespace Matching {
+	#define JOURNAL_MAGIC "MATCHJNL"
+	#define JOURNAL_VERSION 1
+
+	struct JournalHeader {
+		char magic[8];
+		uint16_t version;
+		uint16_t reserved[11];
+	};
+
+	static_assert(sizeof(JournalHeader) == sizeof(LogRecord), "the journal header is one record long");
+
+	struct JournalConfig {
+		size_t batchRecords; //commit once this many records are pending
+		int windowUs; //or once the oldest pending record waited this long
+		bool sync; //false : write only, the OS decides when it hits the disk
+		size_t ringSize;
+
+		JournalConfig() : batchRecords(256), windowUs(200), sync(true), ringSize(1 << 16) {}
+	};
+
+	class Journal {
+	private:
+		int fd;
+		JournalConfig config;
+		SpscQueue<LogRecord>* ring;
+		thread writer;
+		atomic<bool> running;
+		atomic<bool> failed;
+		atomic<uint64_t> durable;
+		//matching thread only
+		uint64_t appended;
+		vector<bool> knownTraders;
+		vector<bool> knownSymbols;
+
+		Journal(const Journal&);
+		Journal& operator=(const Journal&);
+
+		void push(const LogRecord& record);
+		//bytes of data padded to whole records
+		void pushData(const char* data, size_t bytes);
+		void pushName(uint8_t type, uint32_t id, const string& name);
+		//I/O thread
+		void work();
+		bool commit(const vector<LogRecord>& batch);
+
+	public:
+		Journal() : fd(-1), ring(NULL), running(false), failed(false), durable(0), appended(0) {}
+		~Journal() { close(); }
+
+		//truncates path and starts the I/O thread
+		bool open(const string& path, const JournalConfig& config = JournalConfig());
+		//commits what is pending and stops the I/O thread. false if a write failed
+		bool close();
+		bool isOpen() const { return fd >= 0; }
+
+		//matching thread. trader and instrument are process ids
+		void append(const LogRecord& record);
+		//a record followed by its data, LOG_RISK_LIMITS
+		void append(const LogRecord& record, const void* data, size_t bytes);
+		//messages appended, LOG_PEAK and LOG_STOP ride along with their order
+		uint64_t getAppended() const { return appended; }
+		//messages committed to disk so far, any thread. it stops once a commit failed
+		uint64_t getDurable() const { return durable.load(memory_order_acquire); }
+		bool hasFailed() const { return failed.load(memory_order_acquire); }
+	};
+
+	/*walks a journal, resolving the names to process ids. next gives the
+	message, LOG_PEAK and LOG_STOP records, with trader and instrument set to process ids */
+	class JournalReader {
+	private:
+		MappedFile file;
+		const LogRecord* pos;
+		const LogRecord* end;
+		vector<TraderId> traders;
+		vector<SymbolId> symbols;
+		LogRecord data;
+
+	public:
+		JournalReader() : pos(NULL), end(NULL) {}
+
+		bool open(const string& path);
+		bool next(LogRecord& record);
+		//the data record of the LOG_RISK_LIMITS next just gave
+		const LogRecord& getData() const { return data; }
+	};
+}
+
+#endif /*JOURNAL_H*/
@@ -1,37 +1,171 @@
 #include <iostream>
+#include <cstdlib>
 #include <unistd.h>
 #include "matchingEngine.h"
+#include "shardedEngine.h"
 using namespace std;
 using namespace Matching;
 
 void usage()
 {
     cout << "Matching Engine\n" << endl;
-    cout << "Usage: matching [-i inputFile]\n" << endl;
+    cout << "Usage: matching [-i inputFile | -b binaryLog] [-c orderCapacity] [-l levelCapacity] [-p priority] [-s stp] [-t shards] [-r snapshot] [-w snapshot] [-J journal] [-j journal] [-m ring]\n" << endl;
     cout << "Options: " << endl;
     cout << "  -i, input file order.csv path. If not specify, default to ../data/orders.csv" << endl;
+    cout << "  -b, replay a binary order log written by csv2bin instead of a CSV file" << endl;
+    cout << "  -c, resting orders preallocated in the book pools. Default 0, pools grow on demand" << endl;
+    cout << "  -l, price levels preallocated in the book pools. Default 0" << endl;
+    cout << "  -p, queue priority of the books : fifo, size, prorata or hybrid (top order then pro-rata). Default fifo" << endl;
+    cout << "  -s, self-trade prevention : none, newest, oldest, both or decrement. Default none" << endl;
+    cout << "  -t, match on this many pinned worker threads, instruments are split between them. Default 0, match on the main thread" << endl;
+    cout << "  -r, restore the books from a snapshot, then only process the input after it" << endl;
+    cout << "  -w, write a snapshot of the books once the input is processed" << endl;
+    cout << "  -J, recover the books from a journal before processing the input" << endl;
+    cout << "  -j, journal the input to this file with group commit while it is processed" << endl;
+    cout << "  -m, publish L2 depth and BBO updates to this shared memory ring, e.g. /dev/shm/matching.md" << endl;
     cout << endl;
 }
 
+//books of named instruments follow the default one
+template<typename Engine>
+void printBooks(const Engine& engine)
+{
+    cout << *engine.getOrderBook() << endl;
+    for(SymbolId symbol = DEFAULT_SYMBOL_ID + 1; symbol < symbolTable().size(); ++symbol) {
+        if(engine.getOrderBook(symbol) == NULL)
+            continue;
+        cout << "Symbol: " << symbolTable().name(symbol) << endl;
+        cout << *engine.getOrderBook(symbol) << endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
 	
     string infile = "../data/orders.csv";
+    string binfile, restorefile, snapshotfile, recoverfile, journalfile, ringfile;
+    BookConfig config;
+    int nShards = 0;
     int opt;
-    while ((opt = getopt(argc, argv, "i:")) != -1) {
+    while ((opt = getopt(argc, argv, "i:b:c:l:p:s:t:r:w:J:j:m:")) != -1) {
         switch(opt) {
         case 'i':
             infile = optarg;
             break;
+        case 'b':
+            binfile = optarg;
+            break;
+        case 'c':
+            config.orderCapacity = atoi(optarg);
+            break;
+        case 'l':
+            config.levelCapacity = atoi(optarg);
+            break;
+        case 'p': {
+            string priority = optarg;
+            if(priority == "fifo")
+                config.priority = PRICE_TIME;
+            else if(priority == "size")
+                config.priority = SIZE_TIME;
+            else if(priority == "prorata")
+                config.priority = PRO_RATA;
+            else if(priority == "hybrid")
+                config.priority = PRO_RATA_TOP;
+            else {
+                usage();
+                return -1;
+            }
+            break;
+        }
+        case 's': {
+            string stp = optarg;
+            if(stp == "none")
+                config.stp = STP_NONE;
+            else if(stp == "newest")
+                config.stp = STP_CANCEL_NEWEST;
+            else if(stp == "oldest")
+                config.stp = STP_CANCEL_OLDEST;
+            else if(stp == "both")
+                config.stp = STP_CANCEL_BOTH;
+            else if(stp == "decrement")
+                config.stp = STP_DECREMENT;
+            else {
+                usage();
+                return -1;
+            }
+            break;
+        }
+        case 't':
+            nShards = atoi(optarg);
+            break;
+        case 'r':
+            restorefile = optarg;
+            break;
+        case 'w':
+            snapshotfile = optarg;
+            break;
+        case 'J':
+            recoverfile = optarg;
+            break;
+        case 'j':
+            journalfile = optarg;
+            break;
+        case 'm':
+            ringfile = optarg;
+            break;
         default:
             usage ();
             return -1;
         }
     }
-    Matching::MatchingEngine me;
-    me.run(infile);
-    OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
-    cout << *orderBook << endl;
+    if(nShards > 0 && !(restorefile.empty() && snapshotfile.empty() && recoverfile.empty() && journalfile.empty() && ringfile.empty())) {
+        cerr << "snapshots, journals and market data need a single threaded run, drop -t" << endl;
+        return -1;
+    }
+    if(nShards > 0) {
+        ShardedEngine engine(nShards, config);
+        int ret = binfile.empty() ? engine.run(infile) : engine.replay(binfile);
+        if(ret == 0)
+            printBooks(engine);
+#ifdef MATCHING_STATS
+        engine.dumpStats(stderr);
+#endif
+        return ret;
+    }
+    Matching::MatchingEngine me(config);
+    if(!restorefile.empty() && !me.loadSnapshot(restorefile))
+        return -1;
+    if(!recoverfile.empty() && me.recover(recoverfile) < 0)
+        return -1;
+    Journal journal;
+    if(!journalfile.empty()) {
+        if(!journal.open(journalfile)) {
+            cerr << "Cannot open journal at " << journalfile << endl;
+            return -1;
+        }
+        me.setJournal(&journal);
+    }
+    MarketDataPublisher publisher;
+    if(!ringfile.empty()) {
+        if(!publisher.open(ringfile)) {
+            cerr << "Cannot open market data ring at " << ringfile << endl;
+            return -1;
+        }
+        me.setPublisher(&publisher);
+    }
+    int ret = binfile.empty() ? me.run(infile) : me.replay(binfile);
+    if(!journal.close()) {
+        cerr << "Cannot write journal " << journalfile << endl;
+        return -1;
+    }
+    if(ret != 0)
+        return ret;
+    if(!snapshotfile.empty() && !me.saveSnapshot(snapshotfile))
+        return -1;
+    printBooks(me);
+#ifdef MATCHING_STATS
+    me.dumpStats(stderr);
+#endif
 
     /*
     MatchingEngine me;
@@ -0,0 +1,42 @@
+/* Implementation of the read-only file mapping */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mappedFile.h"
+
+namespace Matching {
+	bool MappedFile::open(const string& path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			return false;
+		struct stat st;
+		if(fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		length = st.st_size;
+		if(length > 0) {
+			void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(p == MAP_FAILED) {
+				::close(fd);
+				length = 0;
+				return false;
+			}
+			madvise(p, length, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(p);
+		}
+		//the mapping stays valid without the descriptor
+		::close(fd);
+		return true;
+	}
+
+	void MappedFile::close() {
+		if(data != NULL)
+			munmap(const_cast<char*>(data), length);
+		data = NULL;
+		length = 0;
+	}
+}
@@ -0,0 +1,31 @@
+/* MappedFile - read-only memory mapping of a whole input file */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+using namespace std;
+
+namespace Matching {
+	//read-only mapping of a whole file
+	class MappedFile {
+	private:
+		const char* data;
+		size_t length;
+
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+	public:
+		MappedFile() : data(NULL), length(0) {}
+		~MappedFile() { close(); }
+
+		bool open(const string& path);
+		void close();
+		const char* begin() const { return data; }
+		const char* end() const { return data + length; }
+		size_t size() const { return length; }
+	};
+}
+
+#endif /*MAPPEDFILE_H*/
@@ -0,0 +1,196 @@
+/* Implementation of the market data publisher and reader */
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "marketData.h"
+
+namespace Matching {
+	bool MarketDataPublisher::open(const string& path, size_t depth_, size_t capacity) {
+		close();
+		size_t cap = 2;
+		while(cap < capacity)
+			cap <<= 1;
+		size_t bytes = sizeof(MarketDataRing) + cap * sizeof(MarketDataUpdate);
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+			return false;
+		void* p = ftruncate(fd, bytes) == 0 ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if(p == MAP_FAILED)
+			return false;
+
+		mapped = bytes;
+		ring = static_cast<MarketDataRing*>(p);
+		updates = reinterpret_cast<MarketDataUpdate*>(ring + 1);
+		ring->capacity = cap;
+		ring->depth = depth_;
+		ring->written.store(0, memory_order_relaxed);
+		//readers check the magic last
+		atomic_thread_fence(memory_order_release);
+		memcpy(ring->magic, MD_MAGIC, sizeof(ring->magic));
+		depth = depth_;
+		pending = 0;
+		batch = 0;
+		views.clear();
+		return true;
+	}
+
+	void MarketDataPublisher::close() {
+		if(ring == NULL)
+			return;
+		commit();
+		munmap(ring, mapped);
+		ring = NULL;
+		updates = NULL;
+		mapped = 0;
+	}
+
+	void MarketDataPublisher::push(uint8_t type, bool bid, SymbolId symbol, const DepthLevel& level) {
+		//a reader only trusts the half of the ring behind the counter, a huge
+		//batch is committed in parts rather than overwrite what it may read
+		if(pending >= ring->capacity / 2)
+			commit();
+		uint64_t at = ring->written.load(memory_order_relaxed) + pending;
+		MarketDataUpdate& u = updates[at & (ring->capacity - 1)];
+		u.type = type;
+		u.bid = bid;
+		u.symbol = symbol;
+		u.orders = level.orders;
+		u.batch = batch;
+		u.price = level.price;
+		u.reserved = 0;
+		u.quantity = level.quantity;
+		++pending;
+	}
+
+	void MarketDataPublisher::pushBbo(SymbolId symbol, const BookView& view) {
+		DepthLevel none = { 0, 0, 0 };
+		for(int bid = 1; bid >= 0; --bid)
+			push(MD_BBO, bid, symbol, view.levels[bid].empty() ? none : view.levels[bid].front());
+	}
+
+	void MarketDataPublisher::diffSide(SymbolId symbol, bool bid, const vector<DepthLevel>& before,
+		const vector<DepthLevel>& after) {
+		//both are best first, merge them by price
+		size_t i = 0, j = 0;
+		while(i < before.size() || j < after.size()) {
+			if(i < before.size() && j < after.size() && before[i].price == after[j].price) {
+				if(before[i] != after[j])
+					push(MD_LEVEL_CHANGE, bid, symbol, after[j]);
+				++i;
+				++j;
+			}
+			else if(j == after.size() || (i < before.size() &&
+				(bid ? before[i].price > after[j].price : before[i].price < after[j].price))) {
+				DepthLevel gone = { before[i].price, 0, 0 };
+				push(MD_LEVEL_DELETE, bid, symbol, gone);
+				++i;
+			}
+			else {
+				push(MD_LEVEL_NEW, bid, symbol, after[j]);
+				++j;
+			}
+		}
+	}
+
+	void MarketDataPublisher::update(SymbolId symbol, const OrderBook& book) {
+		if(symbol >= views.size())
+			views.resize(symbol + 1);
+		BookView& view = views[symbol];
+		if(view.version == book.getVersion())
+			return;
+		view.version = book.getVersion();
+		bool topMoved = false;
+		for(int bid = 1; bid >= 0; --bid) {
+			vector<DepthLevel>& before = view.levels[bid];
+			book.getDepth(bid, depth, current);
+			if(before.empty() != current.empty() || (!before.empty() && before.front() != current.front()))
+				topMoved = true;
+			diffSide(symbol, bid, before, current);
+			before.swap(current);
+		}
+		if(topMoved)
+			pushBbo(symbol, view);
+	}
+
+	void MarketDataPublisher::snapshot(SymbolId symbol, const OrderBook& book) {
+		if(symbol >= views.size())
+			views.resize(symbol + 1);
+		BookView& view = views[symbol];
+		view.version = book.getVersion();
+		DepthLevel none = { 0, 0, 0 };
+		push(MD_SNAPSHOT, false, symbol, none);
+		for(int bid = 1; bid >= 0; --bid) {
+			book.getDepth(bid, depth, view.levels[bid]);
+			for(size_t i = 0; i < view.levels[bid].size(); ++i)
+				push(MD_LEVEL_NEW, bid, symbol, view.levels[bid][i]);
+		}
+		pushBbo(symbol, view);
+	}
+
+	void MarketDataPublisher::commit() {
+		if(pending == 0)
+			return;
+		ring->written.store(ring->written.load(memory_order_relaxed) + pending, memory_order_release);
+		pending = 0;
+		++batch;
+	}
+
+	bool MarketDataReader::open(const string& path) {
+		close();
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			return false;
+		struct stat st;
+		void* p = MAP_FAILED;
+		if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(MarketDataRing))
+			p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(p == MAP_FAILED)
+			return false;
+		mapped = st.st_size;
+		ring = static_cast<const MarketDataRing*>(p);
+		updates = reinterpret_cast<const MarketDataUpdate*>(ring + 1);
+		if(memcmp(ring->magic, MD_MAGIC, sizeof(ring->magic)) != 0 ||
+			mapped != sizeof(MarketDataRing) + (size_t)ring->capacity * sizeof(MarketDataUpdate)) {
+			close();
+			return false;
+		}
+		atomic_thread_fence(memory_order_acquire);
+		pos = ring->written.load(memory_order_acquire);
+		return true;
+	}
+
+	void MarketDataReader::close() {
+		if(ring != NULL)
+			munmap(const_cast<MarketDataRing*>(ring), mapped);
+		ring = NULL;
+		updates = NULL;
+		mapped = 0;
+	}
+
+	long MarketDataReader::read(MarketDataUpdate* out, size_t max) {
+		uint64_t safe = ring->capacity / 2;
+		uint64_t written = ring->written.load(memory_order_acquire);
+		if(written - pos > safe) {
+			pos = written;
+			return -1;
+		}
+		size_t n = min((uint64_t)max, written - pos);
+		for(size_t i = 0; i < n; ++i)
+			out[i] = updates[(pos + i) & (ring->capacity - 1)];
+		//the writer may have gone on meanwhile, what it could have overwritten
+		//is only known after the copy
+		atomic_thread_fence(memory_order_acquire);
+		written = ring->written.load(memory_order_relaxed);
+		if(written - pos > safe) {
+			pos = written;
+			return -1;
+		}
+		pos += n;
+		return n;
+	}
+}
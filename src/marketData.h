@@ -0,0 +1,134 @@
+/* Market data - incremental L2 depth and BBO updates in a shared memory ring */
+/* The publisher keeps, per book, the depth-N view it last published. update()
+returns at once when the book version did not move, otherwise it walks the
+best N levels of each side (O(N), the levels carry their aggregated quantity
+and order count, no order is visited) and diffs them against the view: a
+price that appeared is LEVEL_NEW, one that left the top N is LEVEL_DELETE, a
+changed quantity or count is LEVEL_CHANGE. A BBO pair (bid then ask) follows
+when the top of either side moved. Whatever a book did between two updates
+is coalesced into one diff, and the updates written before a commit() become
+visible to readers together. Depth 0 publishes every level.
+
+The ring is a file mapped MAP_SHARED, put it on /dev/shm to keep it in
+memory. Readers map it read only and poll the write counter, no syscall once
+mapped. The writer never waits for readers: a reader that falls more than half
+the ring behind is told it was lapped and resyncs from a snapshot.
+
+Layout:
+	MarketDataRing                  128 bytes
+	updates                         capacity x 32 bytes (MarketDataUpdate) */
+
+#ifndef MARKETDATA_H
+#define MARKETDATA_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "orderbook.h"
+#include "spscQueue.h"
+
+namespace Matching {
+	#define MD_MAGIC "MATCHMD1"
+	#define MD_RING_SIZE (1 << 16)
+	#define MD_DEPTH 10
+
+	enum MarketDataType {
+		MD_LEVEL_NEW = 1,
+		MD_LEVEL_CHANGE = 2,
+		MD_LEVEL_DELETE = 3,
+		//one per side, bid first. quantity 0 : the side is empty
+		MD_BBO = 4,
+		//the levels of the symbol that follow replace everything before
+		MD_SNAPSHOT = 5
+	};
+
+	struct MarketDataUpdate {
+		uint8_t type; //MarketDataType
+		uint8_t bid; //1 for the bid side
+		uint16_t symbol;
+		uint32_t orders;
+		uint64_t batch; //commit that published it
+		int32_t price;
+		uint32_t reserved;
+		int64_t quantity;
+	};
+
+	struct MarketDataRing {
+		char magic[8];
+		uint32_t capacity; //power of two
+		uint32_t depth;
+		alignas(CACHE_LINE) atomic<uint64_t> written;
+	};
+
+	static_assert(sizeof(MarketDataUpdate) == 32, "MarketDataUpdate is 32 bytes in the ring");
+	static_assert(sizeof(MarketDataRing) == 2 * CACHE_LINE, "the ring header keeps the counter on its own line");
+	static_assert(atomic<uint64_t>::is_always_lock_free, "the ring counter is shared between processes");
+
+	class MarketDataPublisher {
+	private:
+		struct BookView {
+			uint64_t version;
+			vector<DepthLevel> levels[2]; //asks, bids
+		};
+
+		MarketDataRing* ring;
+		MarketDataUpdate* updates;
+		size_t mapped;
+		size_t depth;
+		uint64_t pending; //updates written since the last commit
+		uint64_t batch;
+		vector<BookView> views; //by SymbolId
+		vector<DepthLevel> current; //scratch
+
+		MarketDataPublisher(const MarketDataPublisher&);
+		MarketDataPublisher& operator=(const MarketDataPublisher&);
+
+		void push(uint8_t type, bool bid, SymbolId symbol, const DepthLevel& level);
+		void pushBbo(SymbolId symbol, const BookView& view);
+		void diffSide(SymbolId symbol, bool bid, const vector<DepthLevel>& before, const vector<DepthLevel>& after);
+
+	public:
+		MarketDataPublisher() : ring(NULL), updates(NULL), mapped(0), depth(MD_DEPTH), pending(0), batch(0) {}
+		~MarketDataPublisher() { close(); }
+
+		//creates (truncates) the ring file. capacity is rounded up to a power of two
+		bool open(const string& path, size_t depth = MD_DEPTH, size_t capacity = MD_RING_SIZE);
+		void close();
+		bool isOpen() const { return ring != NULL; }
+
+		//diffs the book against what was last published for symbol
+		void update(SymbolId symbol, const OrderBook& book);
+		//every published level of the book, O(depth). for a late reader or after a lap
+		void snapshot(SymbolId symbol, const OrderBook& book);
+		//makes every update since the last commit visible to the readers
+		void commit();
+		uint64_t getWritten() const { return ring->written.load(memory_order_relaxed) + pending; }
+	};
+
+	class MarketDataReader {
+	private:
+		const MarketDataRing* ring;
+		const MarketDataUpdate* updates;
+		size_t mapped;
+		uint64_t pos;
+
+		MarketDataReader(const MarketDataReader&);
+		MarketDataReader& operator=(const MarketDataReader&);
+
+	public:
+		MarketDataReader() : ring(NULL), updates(NULL), mapped(0), pos(0) {}
+		~MarketDataReader() { close(); }
+
+		//maps the ring shared and read only, starts at its current end
+		bool open(const string& path);
+		void close();
+		size_t getDepth() const { return ring->depth; }
+		/*copies up to max updates into out. returns the number copied, or -1
+		when the writer lapped the reader, which then skips to the end of the
+		ring and should resync from a snapshot */
+		long read(MarketDataUpdate* out, size_t max);
+	};
+}
+
+#endif /*MARKETDATA_H*/
@@ -10,62 +10,595 @@ pricessing orders
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <chrono>
 #include "matchingEngine.h"
 #include "orderbook.h"
+#include "csvReader.h"
+#include "snapshot.h"
 
 namespace Matching {
-	MatchingEngine::MatchingEngine() {
-		orderBook = new OrderBook();
+	MatchingEngine::MatchingEngine(const BookConfig& config) : defaultConfig(config), events(NULL), sequence(0), journal(NULL),
+	publisher(NULL), publishBatch(1), unpublished(0), nextPeak(0), nextTrigger(INAN) {
+		createBook(DEFAULT_SYMBOL_ID, config);
 		vector<string> names{TRADER};
 		init(names);
 	}
 
+	OrderBook* MatchingEngine::createBook(SymbolId symbol, const BookConfig& config) {
+		if(symbol >= books.size())
+			books.resize(symbol + 1, NULL);
+		OrderBook* book = new OrderBook(config);
+		book->setEventBuffer(events);
+		for(size_t i = 0; i < traders.size(); ++i)
+			book->bookTradeForTrader(traders[i]);
+		books[symbol] = book;
+		return book;
+	}
+
+	size_t MatchingEngine::getBookCount() const {
+		size_t n = 0;
+		for(size_t i = 0; i < books.size(); ++i)
+			n += books[i] != NULL;
+		return n;
+	}
+
+	bool MatchingEngine::addInstrument(const string& symbol, const BookConfig& config) {
+		SymbolId id = symbolTable().intern(symbol);
+		if(id < books.size() && books[id] != NULL)
+			return false;
+		createBook(id, config);
+		return true;
+	}
+
 	void MatchingEngine::init(const vector<string>& names) {
-		orderBook->bookTradeForTrader(names);
+		for(const string& name : names)
+			traders.push_back(traderTable().intern(name));
+		for(size_t i = 0; i < books.size(); ++i)
+			if(books[i] != NULL)
+				books[i]->bookTradeForTrader(names);
 	}
 
-	void MatchingEngine::processOrder(Order* order) {
+	void MatchingEngine::setEventBuffer(EventBuffer* buffer) {
+		events = buffer;
+		for(size_t i = 0; i < books.size(); ++i)
+			if(books[i] != NULL)
+				books[i]->setEventBuffer(buffer);
+	}
+
+	void MatchingEngine::setPublisher(MarketDataPublisher* publisher_, size_t batch) {
+		publisher = publisher_;
+		publishBatch = batch > 0 ? batch : 1;
+		unpublished = 0;
+		if(publisher == NULL)
+			return;
+		//readers start from the full view
+		for(SymbolId symbol = 0; symbol < books.size(); ++symbol)
+			if(books[symbol] != NULL)
+				publisher->snapshot(symbol, *books[symbol]);
+		publisher->commit();
+	}
+
+	void MatchingEngine::publishMarketData() {
+		unpublished = 0;
+		if(publisher == NULL)
+			return;
+		for(SymbolId symbol = 0; symbol < books.size(); ++symbol)
+			if(books[symbol] != NULL)
+				publisher->update(symbol, *books[symbol]);
+		publisher->commit();
+	}
+
+	void MatchingEngine::clean() {
+		for(size_t i = 0; i < books.size(); ++i)
+			delete books[i];
+		books.clear();
+	}
+
+	int MatchingEngine::getTraderExposure(const string& name) const {
+		int exposure = 0;
+		for(size_t i = 0; i < books.size(); ++i)
+			if(books[i] != NULL)
+				exposure += books[i]->getTraderExposure(name);
+		return exposure;
+	}
+
+	int MatchingEngine::processOrder(Order* order, int peak) {
+		++sequence;
+		if(journal != NULL) {
+			if(peak > 0) {
+				LogRecord record = { LOG_PEAK, 0, order->symbol, 0, order->id, 0, 0, peak };
+				journal->append(record);
+			}
+			journal->append(newRecord(*order, order->symbol));
+		}
+		OrderBook* book = bookFor(order->symbol);
+		int qtyToMatch = book->execute(order, peak);
+		runTriggered(book);
+		messageDone();
+		return qtyToMatch;
+	}
+
+	int MatchingEngine::processStop(Order* order, int trigger) {
+		++sequence;
+		if(journal != NULL) {
+			LogRecord record = { LOG_STOP, 0, order->symbol, 0, order->id, 0, trigger, 0 };
+			journal->append(record);
+			journal->append(newRecord(*order, order->symbol));
+		}
+		OrderBook* book = bookFor(order->symbol);
 		int qtyToMatch = order->quantity;
-		orderBook->match(order,qtyToMatch);
-		//post non marketable portion
-		if(qtyToMatch > 0) {
-			if(qtyToMatch != order->quantity)
-				order->quantity = qtyToMatch;
-			orderBook->add(order);
+		if(!book->addStop(order, trigger)) {
+			qtyToMatch = book->execute(order);
+			runTriggered(book);
+		}
+		messageDone();
+		return qtyToMatch;
+	}
+
+	bool MatchingEngine::cancelOrder(OrderId id, SymbolId symbol) {
+		++sequence;
+		if(journal != NULL) {
+			LogRecord record = { LOG_CANCEL, 0, (uint16_t)symbol, 0, id, 0, 0, 0 };
+			journal->append(record);
+		}
+		bool found = symbol < books.size() && books[symbol] != NULL && books[symbol]->cancel(id);
+		messageDone();
+		return found;
+	}
+
+	bool MatchingEngine::replaceOrder(OrderId id, int newPrice, int newQty, SymbolId symbol) {
+		++sequence;
+		if(journal != NULL) {
+			LogRecord record = { LOG_REPLACE, 0, (uint16_t)symbol, 0, id, 0, newPrice, newQty };
+			journal->append(record);
+		}
+		bool found = symbol < books.size() && books[symbol] != NULL && books[symbol]->replace(id, newPrice, newQty);
+		if(found)
+			runTriggered(books[symbol]);
+		messageDone();
+		return found;
+	}
+
+	size_t MatchingEngine::processBatch(const LogRecord* records, size_t n) {
+		//the publisher is set aside so the batch is diffed once, at its end
+		MarketDataPublisher* deferred = publisher;
+		publisher = NULL;
+		uint64_t first = sequence;
+		for(size_t i = 0; i < n; ++i) {
+			if(records[i].type == LOG_RISK_LIMITS && i + 1 < n) {
+				applyRiskLimits(records[i], records[i + 1]);
+				++i;
+			}
+			else
+				applyRecord(records[i], records[i].trader, records[i].instrument);
+		}
+		publisher = deferred;
+		size_t nMessages = sequence - first;
+		if(publisher != NULL && nMessages > 0) {
+			unpublished += nMessages;
+			if(unpublished >= publishBatch)
+				publishMarketData();
+		}
+		return nMessages;
+	}
+
+	void MatchingEngine::beginAuction(SymbolId symbol) {
+		++sequence;
+		if(journal != NULL) {
+			LogRecord record = { LOG_AUCTION, 0, (uint16_t)symbol, 0, 0, 0, 0, 1 };
+			journal->append(record);
+		}
+		bookFor(symbol)->beginAuction();
+		messageDone();
+	}
+
+	int64_t MatchingEngine::uncross(SymbolId symbol) {
+		++sequence;
+		if(journal != NULL) {
+			LogRecord record = { LOG_AUCTION, 0, (uint16_t)symbol, 0, 0, 0, 0, 0 };
+			journal->append(record);
+		}
+		OrderBook* book = bookFor(symbol);
+		int64_t volume = book->uncross();
+		runTriggered(book);
+		messageDone();
+		return volume;
+	}
+
+	void MatchingEngine::setRiskLimits(const string& name, const RiskLimits& limits, SymbolId symbol) {
+		TraderId trader = traderTable().intern(name);
+		if(journal != NULL) {
+			LogRecord record = { LOG_RISK_LIMITS, 0, symbol, trader, 0, 0, 0, 0 };
+			//field by field, so the padding goes to the journal as zeros
+			RiskLimits data;
+			memset(&data, 0, sizeof(data));
+			data.maxOrderQty = limits.maxOrderQty;
+			data.maxOpenQty = limits.maxOpenQty;
+			data.maxPosition = limits.maxPosition;
+			data.maxNotional = limits.maxNotional;
+			journal->append(record, &data, sizeof(data));
+		}
+		bookFor(symbol)->setRiskLimits(trader, limits);
+	}
+
+	void MatchingEngine::applyRiskLimits(const LogRecord& record, const LogRecord& data) {
+		static_assert(sizeof(RiskLimits) <= sizeof(LogRecord), "RiskLimits fit in one journal record");
+		RiskLimits limits;
+		memcpy(&limits, &data, sizeof(limits));
+		bookFor(record.instrument)->setRiskLimits(record.trader, limits);
+	}
+
+	void MatchingEngine::processRecord(const LogRecord& record, const TraderId* traders, const SymbolId* symbols) {
+		applyRecord(record, record.type == LOG_NEW ? traders[record.trader] : 0, symbols[record.instrument]);
+	}
+
+	void MatchingEngine::applyRecord(const LogRecord& record, TraderId trader, SymbolId symbol) {
+		switch(record.type) {
+		case LOG_NEW: {
+			Order* order = bookFor(symbol)->newOrder();
+			order->id = record.id;
+			order->time = record.time;
+			order->price = record.price;
+			order->quantity = record.quantity;
+			order->trader = trader;
+			order->symbol = symbol;
+			order->flags = record.flags;
+			int peak = nextPeak, trigger = nextTrigger;
+			nextPeak = 0;
+			nextTrigger = INAN;
+			if(trigger != INAN)
+				processStop(order, trigger);
+			else
+				processOrder(order, peak);
+			break;
+		}
+		case LOG_PEAK:
+			nextPeak = record.quantity;
+			break;
+		case LOG_STOP:
+			nextTrigger = record.price;
+			break;
+		case LOG_CANCEL:
+			cancelOrder(record.id, symbol);
+			break;
+		case LOG_REPLACE:
+			replaceOrder(record.id, record.price, record.quantity, symbol);
+			break;
+		case LOG_AUCTION:
+			if(record.quantity)
+				beginAuction(symbol);
+			else
+				uncross(symbol);
+			break;
 		}
 	}
 
 	int MatchingEngine::run(const string& inFile) {
-		FILE* file = fopen(inFile.c_str(), "r");
-		if(NULL == file) {
+		CsvOrderReader reader;
+		if(!reader.open(inFile)) {
 			fprintf(stderr, "Cannot open file at %s\n", inFile.c_str());
 			return -1;
 		}
 
-		int id,quantity,time;
-		char name[20],buySellStr[5];
-		float price;
-		while(!feof(file)) {
-			int nItemsRead = fscanf(file,"%d,%[^,],%f,%d,%d,%s\n",
-				&id,name,&price,&quantity,&time,buySellStr);
-			if(NCOL != nItemsRead)
-			{
-				cout << "Bad line" << endl;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t nOrders = 0;
+		//orders a restored snapshot already holds
+		uint64_t skip = sequence;
+		Order parsed;
+		while(reader.next(parsed)) {
+			if(skip > 0) {
+				--skip;
+				continue;
 			}
+			processOrder(bookFor(parsed.symbol)->newOrder(parsed));
+			++nOrders;
+		}
+		//the last batch may be short
+		publishMarketData();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		reportThroughput(reader.getBytes(), nOrders, reader.getBadLines(), seconds);
 
-			bool isBuy = strcmp(BUYSTR,buySellStr) == 0;
-			int priceInt = price;
-			Order* order = new Order(id,name,priceInt,quantity,time,isBuy);
-			processOrder(order);
-			//cout<<*orderBook<<endl;
+		int exposure = getTraderExposure(TRADER);
+		string str = exposure >= 0 ? "L" : "S";
+		cout << str << endl;
+		cout << abs(exposure) << endl;
+		return 0;
+	}
+
+	int MatchingEngine::replay(const string& binFile) {
+		BinaryLogReader reader;
+		if(!reader.open(binFile)) {
+			fprintf(stderr, "Cannot open binary log at %s\n", binFile.c_str());
+			return -1;
 		}
-		//OrderBook* orderBook = const_cast< OrderBook* >( getOrderBook() );
-		
-		int exposure = orderBook->getTraderExposure(TRADER);
+		//intern both tables once, records only carry indices
+		vector<TraderId> traders;
+		for(const string& name : reader.getTraders())
+			traders.push_back(traderTable().intern(name));
+		vector<SymbolId> symbols;
+		for(const string& name : reader.getInstruments())
+			symbols.push_back(symbolTable().intern(name));
+		if(sequence > reader.size()) {
+			fprintf(stderr, "%s has %llu records, the engine is already at %llu\n", binFile.c_str(),
+				(unsigned long long)reader.size(), (unsigned long long)sequence);
+			return -1;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t nRecords = reader.size() - sequence;
+		for(const LogRecord* record = reader.begin() + sequence; record != reader.end(); ++record) {
+			if(reader.check(*record))
+				processRecord(*record, traders.data(), symbols.data());
+			//a bad record keeps its place, so a snapshot's sequence still points into the log
+			else
+				++sequence;
+		}
+		publishMarketData();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		reportThroughput(nRecords * sizeof(LogRecord), nRecords - reader.getBadRecords(), reader.getBadRecords(), seconds);
+
+		int exposure = getTraderExposure(TRADER);
 		string str = exposure >= 0 ? "L" : "S";
 		cout << str << endl;
 		cout << abs(exposure) << endl;
 		return 0;
 	}
 
-}
\ No newline at end of file
+	int64_t MatchingEngine::recover(const string& journalPath) {
+		JournalReader reader;
+		if(!reader.open(journalPath)) {
+			fprintf(stderr, "Cannot open journal at %s\n", journalPath.c_str());
+			return -1;
+		}
+		//the reader already maps both ids to the interned ones
+		int64_t n = 0;
+		LogRecord record;
+		while(reader.next(record)) {
+			if(record.type == LOG_RISK_LIMITS)
+				applyRiskLimits(record, reader.getData());
+			else
+				applyRecord(record, record.trader, record.instrument);
+			n += isMessage(record.type);
+		}
+		return n;
+	}
+
+	//index of the trader in the file table, added on first use
+	static uint32_t fileTrader(TraderId trader, vector<uint32_t>& fileIndex, vector<TraderId>& used) {
+		if(fileIndex[trader] == NO_ID) {
+			fileIndex[trader] = used.size();
+			used.push_back(trader);
+		}
+		return fileIndex[trader];
+	}
+
+	bool MatchingEngine::saveSnapshot(const string& path) const {
+		/*the file table only holds the traders the books refer to: booked
+		traders (the engine's and the ones with an exposure) and the owners
+		of resting orders */
+		vector<uint32_t> fileIndex(traderTable().size(), NO_ID);
+		vector<TraderId> used;
+		for(size_t i = 0; i < traders.size(); ++i)
+			fileTrader(traders[i], fileIndex, used);
+		for(SymbolId symbol = 0; symbol < books.size(); ++symbol) {
+			const OrderBook* book = books[symbol];
+			if(book == NULL)
+				continue;
+			const AccountMap& account = book->getAccount();
+			for(TraderId t = 0; t < account.size(); ++t)
+				if(book->isBooked(t))
+					fileTrader(t, fileIndex, used);
+			const PriceLadder* ladders[] = { book->getBids(), book->getAsks() };
+			for(const PriceLadder* ladder : ladders)
+				for(const PriceNode* level = ladder->best(); level != NULL; level = ladder->next(level->getPrice()))
+					for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next)
+						fileTrader(slot->order->trader, fileIndex, used);
+			for(BuyStops::const_iterator it = book->getBuyStops().begin(); it != book->getBuyStops().end(); ++it)
+				fileTrader(it->second->trader, fileIndex, used);
+			for(SellStops::const_iterator it = book->getSellStops().begin(); it != book->getSellStops().end(); ++it)
+				fileTrader(it->second->trader, fileIndex, used);
+		}
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if(file == NULL)
+			return false;
+		SnapshotHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+		header.version = SNAPSHOT_VERSION;
+		header.bookCount = getBookCount();
+		header.traderCount = used.size();
+		header.sequence = sequence;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		for(size_t i = 0; ok && i < used.size(); ++i) {
+			const string& name = traderTable().name(used[i]);
+			char buf[LOG_NAME_LEN] = {0};
+			ok = name.size() <= LOG_NAME_LEN;
+			memcpy(buf, name.data(), ok ? name.size() : 0);
+			ok = ok && fwrite(buf, LOG_NAME_LEN, 1, file) == 1;
+		}
+
+		for(SymbolId symbol = 0; ok && symbol < books.size(); ++symbol) {
+			const OrderBook* book = books[symbol];
+			if(book == NULL)
+				continue;
+			const PriceLadder* ladders[] = { book->getBids(), book->getAsks() };
+			const AccountMap& account = book->getAccount();
+			SnapshotBook entry;
+			memset(&entry, 0, sizeof(entry));
+			const string& name = symbolTable().name(symbol);
+			ok = name.size() <= LOG_SYMBOL_LEN;
+			memcpy(entry.symbol, name.data(), ok ? name.size() : 0);
+			entry.priority = book->getConfig().priority;
+			entry.ladder = book->getConfig().ladder;
+			entry.minAllocation = book->getConfig().minAllocation;
+			entry.collar = book->getConfig().collar;
+			entry.stp = book->getConfig().stp;
+			entry.basePrice = book->getConfig().basePrice;
+			entry.numTicks = book->getConfig().numTicks;
+			entry.stopCount = book->getStopCount();
+			entry.lastTradePrice = book->getLastTradePrice();
+			entry.auction = book->inAuction();
+			for(TraderId t = 0; t < account.size(); ++t)
+				entry.accountCount += book->isBooked(t);
+			for(const PriceLadder* ladder : ladders) {
+				entry.levelCount += ladder->size();
+				for(const PriceNode* level = ladder->best(); level != NULL; level = ladder->next(level->getPrice())) {
+					entry.orderCount += level->getQueue().size();
+					for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next)
+						entry.icebergCount += slot->peak > 0;
+				}
+			}
+			ok = ok && fwrite(&entry, sizeof(entry), 1, file) == 1;
+			for(TraderId t = 0; ok && t < account.size(); ++t) {
+				if(!book->isBooked(t))
+					continue;
+				SnapshotExposure exposure = { fileIndex[t], account[t] };
+				ok = fwrite(&exposure, sizeof(exposure), 1, file) == 1;
+			}
+			for(const PriceLadder* ladder : ladders)
+				for(const PriceNode* level = ladder->best(); ok && level != NULL; level = ladder->next(level->getPrice()))
+					for(const OrderSlot* slot = level->getQueue().front(); ok && slot != NULL; slot = slot->next) {
+						Order order = *slot->order;
+						order.trader = fileIndex[order.trader];
+						ok = fwrite(&order, sizeof(order), 1, file) == 1;
+					}
+			for(const PriceLadder* ladder : ladders)
+				for(const PriceNode* level = ladder->best(); ok && level != NULL; level = ladder->next(level->getPrice()))
+					for(const OrderSlot* slot = level->getQueue().front(); ok && slot != NULL; slot = slot->next) {
+						if(slot->peak == 0)
+							continue;
+						SnapshotIceberg iceberg = { slot->order->id, slot->peak, slot->reserve };
+						ok = fwrite(&iceberg, sizeof(iceberg), 1, file) == 1;
+					}
+			vector<pair<int, const Order*> > stops(book->getBuyStops().begin(), book->getBuyStops().end());
+			stops.insert(stops.end(), book->getSellStops().begin(), book->getSellStops().end());
+			for(size_t i = 0; ok && i < stops.size(); ++i) {
+				SnapshotStop stop;
+				memset(&stop, 0, sizeof(stop));
+				stop.order = *stops[i].second;
+				stop.order.trader = fileIndex[stop.order.trader];
+				stop.trigger = stops[i].first;
+				ok = fwrite(&stop, sizeof(stop), 1, file) == 1;
+			}
+		}
+		ok = fclose(file) == 0 && ok;
+		if(!ok)
+			fprintf(stderr, "Cannot write snapshot %s (names are limited to %d chars, symbols to %d)\n",
+				path.c_str(), LOG_NAME_LEN, LOG_SYMBOL_LEN);
+		return ok;
+	}
+
+	bool MatchingEngine::loadSnapshot(const string& path) {
+		MappedFile file;
+		if(!file.open(path) || file.size() < sizeof(SnapshotHeader)) {
+			fprintf(stderr, "Cannot open snapshot at %s\n", path.c_str());
+			return false;
+		}
+		const char* p = file.begin();
+		const char* end = file.end();
+		SnapshotHeader header;
+		memcpy(&header, p, sizeof(header));
+		p += sizeof(header);
+		if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+			(size_t)(end - p) < (size_t)header.traderCount * LOG_NAME_LEN) {
+			fprintf(stderr, "%s is not a snapshot\n", path.c_str());
+			return false;
+		}
+		vector<TraderId> traders;
+		traders.reserve(header.traderCount);
+		for(uint32_t i = 0; i < header.traderCount; ++i, p += LOG_NAME_LEN)
+			traders.push_back(traderTable().intern(string_view(p, strnlen(p, LOG_NAME_LEN))));
+
+		uint32_t b = 0;
+		for(; b < header.bookCount; ++b) {
+			SnapshotBook entry;
+			if((size_t)(end - p) < sizeof(entry))
+				break;
+			memcpy(&entry, p, sizeof(entry));
+			p += sizeof(entry);
+			size_t bytes = entry.accountCount * sizeof(SnapshotExposure) + entry.orderCount * sizeof(Order) +
+				entry.icebergCount * sizeof(SnapshotIceberg) + entry.stopCount * sizeof(SnapshotStop);
+			if((size_t)(end - p) < bytes)
+				break;
+
+			BookConfig config = defaultConfig;
+			config.priority = PriorityPolicy(entry.priority);
+			config.ladder = LadderType(entry.ladder);
+			config.minAllocation = entry.minAllocation;
+			config.collar = entry.collar;
+			config.stp = (StpMode)entry.stp;
+			config.basePrice = entry.basePrice;
+			config.numTicks = entry.numTicks;
+			SymbolId symbol = symbolTable().intern(string_view(entry.symbol, strnlen(entry.symbol, LOG_SYMBOL_LEN)));
+			if(symbol < books.size() && books[symbol] != NULL) {
+				delete books[symbol];
+				books[symbol] = NULL;
+			}
+			OrderBook* book = createBook(symbol, config);
+			book->reserve(entry.orderCount, entry.levelCount);
+
+			for(uint32_t i = 0; i < entry.accountCount; ++i, p += sizeof(SnapshotExposure)) {
+				SnapshotExposure exposure;
+				memcpy(&exposure, p, sizeof(exposure));
+				if(exposure.trader < traders.size())
+					book->setExposure(traders[exposure.trader], exposure.exposure);
+			}
+			for(uint64_t i = 0; i < entry.orderCount; ++i, p += sizeof(Order)) {
+				Order* order = book->newOrder();
+				memcpy(order, p, sizeof(Order));
+				order->trader = order->trader < traders.size() ? traders[order->trader] : 0;
+				order->symbol = symbol;
+				if(!book->add(order))
+					book->releaseOrder(order);
+			}
+			for(uint32_t i = 0; i < entry.icebergCount; ++i, p += sizeof(SnapshotIceberg)) {
+				SnapshotIceberg iceberg;
+				memcpy(&iceberg, p, sizeof(iceberg));
+				book->setReserve(iceberg.id, iceberg.peak, iceberg.reserve);
+			}
+			book->setLastTradePrice(entry.lastTradePrice);
+			if(entry.auction)
+				book->beginAuction();
+			for(uint32_t i = 0; i < entry.stopCount; ++i, p += sizeof(SnapshotStop)) {
+				SnapshotStop stop;
+				memcpy(&stop, p, sizeof(stop));
+				Order* order = book->newOrder(stop.order);
+				order->trader = order->trader < traders.size() ? traders[order->trader] : 0;
+				order->symbol = symbol;
+				if(!book->addStop(order, stop.trigger))
+					book->releaseOrder(order);
+			}
+		}
+		if(b < header.bookCount) {
+			fprintf(stderr, "Snapshot %s is truncated\n", path.c_str());
+			return false;
+		}
+		sequence = header.sequence;
+		return true;
+	}
+
+#ifdef MATCHING_STATS
+	void MatchingEngine::dumpStats(FILE* out) const {
+		BookStats total;
+		size_t n = 0;
+		for(size_t i = 0; i < books.size(); ++i) {
+			if(books[i] == NULL)
+				continue;
+			books[i]->getStats().print(out, symbolTable().name(i).c_str());
+			total.merge(books[i]->getStats());
+			++n;
+		}
+		if(n > 1)
+			total.print(out, "total");
+	}
+#endif
+
+	void MatchingEngine::reportThroughput(size_t bytes, size_t nOrders, size_t badLines, double seconds) {
+		if(seconds <= 0)
+			seconds = 1e-9;
+		fprintf(stderr, "%zu orders (%zu bad lines), %.1f MB in %.3f s : %.1f MB/s, %.0f orders/s\n",
+			nOrders, badLines, bytes / 1e6, seconds, bytes / 1e6 / seconds, nOrders / seconds);
+	}
+
+}
@@ -2,26 +2,145 @@
 #ifndef MATCHING_ENGINE_H
 #define MATCHING_ENGINE_H
 #include "orderbook.h"
+#include "binaryLog.h"
+#include "journal.h"
+#include "marketData.h"
 
 namespace Matching {
-	#define BUYSTR "BUY"
 	#define TRADER "Poonam"
-	#define NCOL 6
 
 
+	/*one book per instrument, indexed by the SymbolId of symbolTable().
+	a book is created the first time its symbol shows up, with the engine's
+	default config, unless addInstrument configured it before */
 	class MatchingEngine {
 	private:
-		OrderBook* orderBook;
+		vector<OrderBook*> books;
+		BookConfig defaultConfig;
+		/*traders booked by every book, including the ones created later.
+		kept interned so a book can be created without touching traderTable() */
+		vector<TraderId> traders;
+		//shared by every book, NULL when nobody listens
+		EventBuffer* events;
+		//input messages (orders, cancels, replaces, auction phases) processed so far
+		uint64_t sequence;
+		//NULL when the input is not journaled
+		Journal* journal;
+		//NULL when no market data is published
+		MarketDataPublisher* publisher;
+		size_t publishBatch;
+		size_t unpublished; //messages since the last publish
+		//peak of a LOG_PEAK record, for the LOG_NEW after it
+		int nextPeak;
+		//trigger of a LOG_STOP record, INAN when the next LOG_NEW is no stop
+		int nextTrigger;
+
+		OrderBook* createBook(SymbolId symbol, const BookConfig& config);
+		//one record whose trader and instrument are already interned ids
+		void applyRecord(const LogRecord& record, TraderId trader, SymbolId symbol);
+		//a LOG_RISK_LIMITS record (interned ids) and the data record after it
+		void applyRiskLimits(const LogRecord& record, const LogRecord& data);
+		/*executes the stops the fills of a message fired, they are not input
+		messages so they are neither journaled nor counted */
+		void runTriggered(OrderBook* book) {
+			for(Order* stop = book->popTriggered(); stop != NULL; stop = book->popTriggered())
+				book->execute(stop);
+		}
+		//after every message, publishes once a batch is complete
+		void messageDone() {
+			if(publisher != NULL && ++unpublished >= publishBatch)
+				publishMarketData();
+		}
 	public:
-		MatchingEngine();
+		MatchingEngine(const BookConfig& config = BookConfig());
 		virtual ~MatchingEngine() { clean(); }
-		const OrderBook* getOrderBook() const { return orderBook; }
+		//NULL if the symbol has no book yet
+		const OrderBook* getOrderBook(SymbolId symbol = DEFAULT_SYMBOL_ID) const {
+			return symbol < books.size() ? books[symbol] : NULL;
+		}
+		//the book of symbol, created on first use
+		OrderBook* bookFor(SymbolId symbol) {
+			if(symbol < books.size() && books[symbol] != NULL)
+				return books[symbol];
+			return createBook(symbol, defaultConfig);
+		}
+		size_t getBookCount() const;
+		/*interns symbol and gives it a book built from config. false if
+		the symbol already has a book */
+		bool addInstrument(const string& symbol, const BookConfig& config);
 
 		void init(const vector<string>& names);
-		void clean() { delete orderBook;}
+		/*every book, including the ones created later, appends its execution
+		events to buffer. clear it after reading the events of a message */
+		void setEventBuffer(EventBuffer* buffer);
+		/*every order, cancel, replace and limit change is appended to journal
+		before it is applied. set it after recover, not before */
+		void setJournal(Journal* journal_) { journal = journal_; }
+		/*the depth and BBO changes of every batch of messages go to publisher
+		(see marketData.h), coalesced per batch. NULL stops publishing */
+		void setPublisher(MarketDataPublisher* publisher_, size_t batch = 1);
+		//publishes what changed since the last batch, even if it is not complete
+		void publishMarketData();
+		void clean();
+		//summed over every book
+		int getTraderExposure(const string& name) const;
+		/*pre-trade limits of a trader in the book of symbol (see RiskLimits).
+		journaled as LOG_RISK_LIMITS, so recover applies them where they were
+		set. not an input message, the sequence does not move. not kept by
+		snapshots either, set them again after a restore */
+		void setRiskLimits(const string& name, const RiskLimits& limits, SymbolId symbol = DEFAULT_SYMBOL_ID);
+		//like replay, the orders before the current sequence number are skipped
 		int run(const string& inFile);
-		void processOrder(Order* order);
+		/*replays a binary order log (see binaryLog.h). records before the
+		current sequence number are skipped, so after loadSnapshot only the
+		tail of the log is replayed */
+		int replay(const string& binFile);
+		uint64_t getSequence() const { return sequence; }
+		/*applies every message and limit change of a journal (see journal.h)
+		in order, a torn last record is ignored. returns the number of messages */
+		int64_t recover(const string& journalPath);
+
+		/*every book, its resting orders in queue order and its exposures,
+		plus the sequence number (see snapshot.h) */
+		bool saveSnapshot(const string& path) const;
+		//replaces the books of the snapshot's symbols, the engine should be fresh
+		bool loadSnapshot(const string& path);
+		/*routes the order to the book of order->symbol. the order must come
+		from new or from that book's newOrder. returns the quantity that did
+		not fill. peak > 0 makes the leaves an iceberg showing peak at a time */
+		int processOrder(Order* order, int peak = 0);
+		/*a stop (ORDER_MARKET) or stop-limit order, held in the trigger book
+		of its symbol until a trade prints at trigger or through it. returns
+		the quantity that did not fill at once, all of it while it waits */
+		int processStop(Order* order, int trigger);
+		bool cancelOrder(OrderId id, SymbolId symbol = DEFAULT_SYMBOL_ID);
+		/*opening or closing auction of a symbol (see OrderBook::beginAuction).
+		both are input messages, journaled as LOG_AUCTION. uncross returns the
+		volume traded at the equilibrium price, the stops it fires run after it */
+		void beginAuction(SymbolId symbol = DEFAULT_SYMBOL_ID);
+		int64_t uncross(SymbolId symbol = DEFAULT_SYMBOL_ID);
+		bool replaceOrder(OrderId id, int newPrice, int newQty, SymbolId symbol = DEFAULT_SYMBOL_ID);
+		/*a burst of input messages, applied in order as if each came on its own.
+		the records are journal records (see journal.h) : trader and instrument
+		are interned ids, a LOG_PEAK or LOG_STOP goes right before its LOG_NEW.
+		a LOG_RISK_LIMITS takes the record after it as its data.
+		the orders come from the book pools and every event of the batch goes
+		to the event buffer, clear it after the batch. market data is diffed
+		once at the end, so readers never see half a batch. it is no faster
+		than one call per message with setPublisher(pub, n), which diffs as
+		often, see bench/batchBench.cpp. returns the number of messages */
+		size_t processBatch(const LogRecord* records, size_t n);
+		/*one log record. traders and symbols map the trader and instrument
+		indices of the record's log to the interned ids, the indices are not
+		checked : pass records BinaryLogReader::check accepted */
+		void processRecord(const LogRecord& record, const TraderId* traders, const SymbolId* symbols);
+	#ifdef MATCHING_STATS
+		//stats of every book and their total
+		void dumpStats(FILE* out) const;
+	#endif
+		//input throughput on stderr, so it never mixes with the results
+		static void reportThroughput(size_t bytes, size_t nOrders, size_t badLines, double seconds);
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,49 +1,101 @@
 /* Order.h - basic structure of a order to be placed */
 #ifndef ORDER_H
 #define ORDER_H
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #include <iostream>
+#include <type_traits>
+#include "interner.h"
 using namespace std;
 
 //create a new namespace for Matching
 namespace Matching {
 	/*Order type is ID,NAME,PRICE,QUANTITY,TIME,BUY/SELL*/
 
+	typedef int64_t OrderId;
+	typedef uint32_t TraderId;
+	typedef uint16_t SymbolId;
+
+	//prices are fixed point, PRICE_SCALE ticks per unit of currency
+	#define PRICE_SCALE 100
+	#define PRICE_DECIMALS 2
+
+	//a price in ticks as the input wrote it : 500 or 500.25, for the printed book
+	inline string priceText(int ticks) {
+		int64_t abs = ticks < 0 ? -(int64_t)ticks : ticks;
+		char buf[32];
+		if(abs % PRICE_SCALE == 0)
+			snprintf(buf, sizeof(buf), "%s%lld", ticks < 0 ? "-" : "", (long long)(abs / PRICE_SCALE));
+		else
+			snprintf(buf, sizeof(buf), "%s%lld.%0*lld", ticks < 0 ? "-" : "", (long long)(abs / PRICE_SCALE),
+				PRICE_DECIMALS, (long long)(abs % PRICE_SCALE));
+		return buf;
+	}
+
+	/*bits of Order::flags. an order without a time in force bit is a GTC
+	limit, its leaves rest in the book */
+	enum OrderFlags {
+		ORDER_BUY = 0x1,
+		ORDER_IOC = 0x2, //leaves are cancelled instead of resting
+		ORDER_FOK = 0x4, //fills completely on arrival or not at all
+		ORDER_MARKET = 0x8, //takes any price, the price field is ignored. implies IOC
+		ORDER_HIDDEN = 0x10, //rests and matches like any order, never shows in the depth
+		ORDER_TIF_MASK = ORDER_IOC | ORDER_FOK | ORDER_MARKET
+	};
+
+	/*compact trivially copyable record, two orders per cache line.
+	the trader is an id from traderTable(), the symbol an id from symbolTable() */
 	typedef struct Order {
-		int id;
+		OrderId id;
+		int64_t time; //just to ensure FIFO.
 		int price;
 		int quantity;
-		int time; //just to ensure FIFO.
-		bool isBuy;
-		string name;
+		TraderId trader;
+		SymbolId symbol;
+		uint16_t flags;
 
 		//initialisation
-		Order(int _id,string _name,int _price, int _quantity, int _time, bool _is_buy) :
-		id(_id), name(_name), price(_price), quantity(_quantity),
-		time(_time), isBuy(_is_buy) {}
+		Order() = default;
+		Order(OrderId _id, TraderId _trader, int _price, int _quantity, int64_t _time, bool _is_buy,
+			SymbolId _symbol = DEFAULT_SYMBOL_ID) :
+		id(_id), time(_time), price(_price), quantity(_quantity),
+		trader(_trader), symbol(_symbol), flags(_is_buy ? ORDER_BUY : 0) {}
+		//interns the name, keep it off the hot path
+		Order(OrderId _id, string_view _name, int _price, int _quantity, int64_t _time, bool _is_buy,
+			SymbolId _symbol = DEFAULT_SYMBOL_ID) :
+		id(_id), time(_time), price(_price), quantity(_quantity),
+		trader(traderTable().intern(_name)), symbol(_symbol), flags(_is_buy ? ORDER_BUY : 0) {}
+
+		bool isBuy() const { return flags & ORDER_BUY; }
+		const string& name() const { return traderTable().name(trader); }
 	} Order;
 
+	static_assert(sizeof(Order) <= 32, "Order must stay within half a cache line");
+	static_assert(is_trivially_copyable<Order>::value, "Order must be trivially copyable");
+
 
 	//operator overloading to print our typical Order
 	inline ostream& operator<<(ostream& os, const Order& order) {
-		os << order.name << "_" << order.price << "_" << order.quantity << "_" << order.time << "_" << order.isBuy;
+		os << order.name() << "_" << priceText(order.price) << "_" << order.quantity << "_" << order.time << "_" << order.isBuy();
 		return os;
 	}
 
 	//comparing 2 orders by overloading ==
 	inline bool operator==(const Order& lhs, const Order& rhs) {
 		return lhs.id == rhs.id &&
-		lhs.name == rhs.name &&
+		lhs.trader == rhs.trader &&
 		lhs.price == rhs.price &&
 		lhs.quantity == rhs.quantity &&
 		lhs.time == rhs.time &&
-		lhs.isBuy == rhs.isBuy;
+		lhs.symbol == rhs.symbol &&
+		lhs.flags == rhs.flags;
 	}
 
-	//returning inequality - just check for == 
+	//returning inequality - just check for ==
 	inline bool operator!=(const Order& lhs, const Order& rhs) {
 		return !(lhs == rhs);
 	}
 }
 
-#endif /*ORDER_H*/
\ No newline at end of file
+#endif /*ORDER_H*/
@@ -0,0 +1,97 @@
+/* OrderFlow - deterministic synthetic order flow for benchmarks */
+/* Every draw comes from one seeded mt19937_64, so a seed always gives the
+same message sequence on any build. Passive orders rest within depth ticks
+of their own side of mid, marketable ones cross up to depth / 4 ticks into
+the other side, and cancels target earlier passive orders (some of which
+have traded away by then, as in real flow). */
+
+#ifndef ORDERFLOW_H
+#define ORDERFLOW_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "order.h"
+#include "binaryLog.h"
+using namespace std;
+
+namespace Matching {
+	struct FlowConfig {
+		uint64_t seed;
+		int mid; //price ticks
+		int depth; //passive orders rest in [mid - depth, mid) and (mid, mid + depth]
+		double buyRatio;
+		double marketableRatio; //of the new orders
+		double cancelRatio; //of all messages
+		int minQty;
+		int maxQty;
+		int nTraders;
+
+		FlowConfig() : seed(1), mid(10000), depth(50), buyRatio(0.5), marketableRatio(0.2),
+		cancelRatio(0.3), minQty(1), maxQty(500), nTraders(16) {}
+	};
+
+	//one input message, type is a LogRecordType, a cancel only sets order.id
+	struct FlowMessage {
+		uint8_t type;
+		Order order;
+	};
+
+	class OrderFlow {
+	private:
+		FlowConfig config;
+		mt19937_64 rng;
+		vector<TraderId> traders;
+		//ids of the passive orders, cancels pick from the recent ones
+		vector<OrderId> passive;
+		OrderId nextId;
+		int64_t time;
+
+		double uniform() { return (rng() >> 11) * (1.0 / 9007199254740992.0); }
+		int between(int lo, int hi) { return lo + (int)(rng() % (uint64_t)(hi - lo + 1)); }
+
+	public:
+		OrderFlow(const FlowConfig& config_) : config(config_), rng(config_.seed), nextId(1), time(0) {
+			for(int i = 0; i < config.nTraders; ++i)
+				traders.push_back(traderTable().intern("flow" + to_string(i)));
+			passive.reserve(1 << 16);
+		}
+
+		const FlowConfig& getConfig() const { return config; }
+		//lowest and highest price the flow can produce
+		int minPrice() const { return config.mid - config.depth; }
+		int maxPrice() const { return config.mid + config.depth; }
+
+		void next(FlowMessage& message) {
+			++time;
+			if(!passive.empty() && uniform() < config.cancelRatio) {
+				//mostly recent orders, like a quoting strategy would cancel
+				size_t window = passive.size() < 1024 ? passive.size() : 1024;
+				size_t pick = passive.size() - 1 - (size_t)(rng() % window);
+				message.type = LOG_CANCEL;
+				message.order = Order(passive[pick], traders[0], 0, 0, time, false);
+				passive[pick] = passive.back();
+				passive.pop_back();
+				return;
+			}
+
+			bool isBuy = uniform() < config.buyRatio;
+			bool marketable = uniform() < config.marketableRatio;
+			int ticks = marketable ? between(0, config.depth / 4) : between(1, config.depth);
+			int price;
+			if(marketable)
+				price = isBuy ? config.mid + ticks : config.mid - ticks;
+			else
+				price = isBuy ? config.mid - ticks : config.mid + ticks;
+			TraderId trader = traders[rng() % traders.size()];
+			message.type = LOG_NEW;
+			message.order = Order(nextId, trader, price, between(config.minQty, config.maxQty), time, isBuy);
+			if(!marketable)
+				passive.push_back(nextId);
+			++nextId;
+		}
+	};
+}
+
+#endif /*ORDERFLOW_H*/
@@ -1,7 +1,8 @@
 /*Order book design */
-/* OrderBook will be a binary sorted tree, and the nodes will
-be bid or ask, they'll have a price and a set of Order pointer and its comparator (which
-is mostly the same for all nodes). Each node will belong to a OrderTree (which is a set) */
+/* OrderBook has a price ladder per side, and the nodes will
+be bid or ask, they'll have a price and a queue of resting orders kept in the
+level priority (price-time FIFO by default, or size-time). Each node will belong to
+a PriceLadder - a PriceTree (which is a map) or a tick indexed array */
 
 
 #ifndef ORDERBOOK_H
@@ -9,43 +10,35 @@ is mostly the same for all nodes). Each node will belong to a OrderTree (which i
 
 #include <map>
 #include <unordered_map>
-#include <set>
 #include <limits>
+#include <cstdlib>
 #include <vector>
 #include <iostream>
 #include "order.h"
+#include "orderqueue.h"
+#include "priceladder.h"
+#include "pool.h"
+#include "events.h"
+#include "bookStats.h"
 using namespace std;
 
 namespace Matching {
 	#define INAN std::numeric_limits<int>::min()
 	#define IS_VALID( x ) ( x != INAN )
 
-	class PriceNode;
-
-	/* Comparator - if size is bigger, return true
-	in case of equal sizes, lesser timestamp one wins */
-	struct OrderSizeTimeComparator {
-		bool operator()(const Order* a, const Order* b) const {
-			int qtya = a->quantity, qtyb = b->quantity;
-			if(qtya != qtyb) return qtya > qtyb;
-			else return a->time < b->time;
-		}
-	};
-
 	//some typedefs for iterators and pointers
-	typedef PriceNode* PriceNodePtr;
-	typedef map<int, PriceNodePtr> PriceTree;
-	//PriceTree will comprise of the price, and the respective pointer
-	//or order corresponding to that price
-	typedef map<int, PriceNodePtr>::iterator PriceTreeIt;
-	typedef map<int,PriceNodePtr>::reverse_iterator PriceTreeRevIt;
-	typedef unordered_map<int, PriceNodePtr> PriceToNodeMap;
-	//a price to Order hash table like structure for all orders
-	typedef unordered_map<int, PriceNodePtr>::iterator PriceToNodeMapIt;
-	typedef set<Order*,OrderSizeTimeComparator> OrderTree;
-	typedef set<Order*, OrderSizeTimeComparator>::iterator OrderTreeIt;
-	typedef unordered_map<string, int> AccountMap;
-	typedef unordered_map<string, int>::iterator AccountMapIt;
+	//order id to its slot, so cancel and amend go straight to the order
+	typedef unordered_map<OrderId, OrderSlot*, hash<OrderId>, equal_to<OrderId>,
+		PoolAllocator<pair<const OrderId, OrderSlot*> > > OrderIndex;
+	typedef OrderIndex::iterator OrderIndexIt;
+	typedef OrderIndex::const_iterator OrderIndexConstIt;
+	//net filled quantity, indexed by trader id
+	typedef vector<int> AccountMap;
+	/*stop orders by trigger price, nearest to the market first. equal
+	triggers keep their arrival order (multimap inserts at the upper bound) */
+	typedef PoolAllocator<pair<const int, Order*> > StopAllocator;
+	typedef multimap<int, Order*, less<int>, StopAllocator> BuyStops;
+	typedef multimap<int, Order*, greater<int>, StopAllocator> SellStops;
 
 	/*each node will be a BUY or SELL entry in our orderbook. 
 	This goes in a map(a self balancing BST) - the trees are separated into
@@ -53,28 +46,72 @@ namespace Matching {
 	class PriceNode {
 	private:
 		int price;
-		set<Order*, OrderSizeTimeComparator>* orderTree;
-		/*pricenode has a price and its tree in a set, whose
-		//value cant be modified once it is added, and there can be only
-		//one Order corresponding to that PriceNode
-		//a priceNode can have multiple nodes since at same price other things
-		//can vary. all those are stored in the orderTree, to which there is a
-		pointer in the code.*/
+		OrderQueue queue;
+		/*resting quantity of the level, kept up to date by the book.
+		quantity is what can match, hidden the part of it that is not shown:
+		iceberg reserves and hidden orders */
+		int64_t quantity;
+		int64_t hidden;
+		int hiddenOrders;
+		/*pricenode has a price and the queue of every order resting
+		at that price, kept in the priority of the book (see OrderQueue).
+		the slots and orders belong to the pools of the book*/
+
+		void count(const OrderSlot* slot, int sign) {
+			bool isHidden = slot->order->flags & ORDER_HIDDEN;
+			quantity += sign * (int64_t)(slot->order->quantity + slot->reserve);
+			hidden += sign * (int64_t)(slot->reserve + (isHidden ? slot->order->quantity : 0));
+			hiddenOrders += sign * isHidden;
+		}
 	public:
-		PriceNode() : price(INAN), orderTree(NULL) {}
-		PriceNode(int price_) : price(price_) { orderTree = new OrderTree(); }
-		void clean(); //implemented later
-		virtual ~PriceNode() { clean(); }
+		PriceNode() : price(INAN), quantity(0), hidden(0), hiddenOrders(0) {}
+		//the arena holds the SIZE_TIME index of the queue
+		PriceNode(int price_, NodeArena* arena = NULL) :
+		price(price_), queue(arena), quantity(0), hidden(0), hiddenOrders(0) {}
 
 		//utility functions
 		int getPrice() const { return price; } //dont modify the price
-		//getOrderTree() gets a reference to a pointer since it may alter its value
-		//this may happen if this is called for a priceNode which is being initialised
-		//here, a new OrderTree will be made as per the constructor
-		//only works when PriceNode is not accessed directly. Used in OrderBook where the PriceNode is accessed by an iterator. 
-		OrderTree*& getOrderTree() { return orderTree; } //returns a reference to the pointer of the OrderTree
-		//OrderTree* getOrderTreeTest() { return orderTree; }
-		void insertOrder(Order* order) { orderTree->emplace(order);}
+		OrderQueue& getQueue() { return queue; }
+		const OrderQueue& getQueue() const { return queue; }
+		bool empty() const { return queue.empty(); }
+		void insertOrder(OrderSlot* slot, PriorityPolicy policy) {
+			queue.insert(slot, policy);
+			count(slot, 1);
+		}
+		void removeOrder(OrderSlot* slot) {
+			queue.unlink(slot);
+			count(slot, -1);
+		}
+		//level aggregates, O(1). the visible ones are what the depth shows
+		int64_t getQuantity() const { return quantity; }
+		int getOrderCount() const { return queue.size(); }
+		int64_t getVisibleQuantity() const { return quantity - hidden; }
+		int getVisibleOrderCount() const { return queue.size() - hiddenOrders; }
+		//the shown quantity of a resting order traded or was amended by delta
+		void addQuantity(const OrderSlot* slot, int64_t delta) {
+			quantity += delta;
+			if(slot->order->flags & ORDER_HIDDEN)
+				hidden += delta;
+		}
+		//takes qty off the reserve of an iceberg
+		void takeReserve(OrderSlot* slot, int qty) {
+			slot->reserve -= qty;
+			quantity -= qty;
+			hidden -= qty;
+		}
+		/*the shown slice of an iceberg is gone : the next one comes out of
+		the reserve and the slot goes to the back of the queue, no allocation
+		and no level lookup. a hidden iceberg keeps its slices hidden */
+		void replenish(OrderSlot* slot, PriorityPolicy policy) {
+			int slice = min(slot->peak, slot->reserve);
+			slot->reserve -= slice;
+			slot->order->quantity = slice;
+			//a hidden order counts its shown slice as hidden already
+			if(!(slot->order->flags & ORDER_HIDDEN))
+				hidden -= slice;
+			queue.unlink(slot);
+			queue.insert(slot, policy);
+		}
 
 		//operator overloading
 		friend ostream& operator<<(ostream& os, const PriceNode& priceNode);
@@ -84,60 +121,386 @@ namespace Matching {
 
 	//friend function
 	inline ostream& operator<<(ostream& os, const PriceNode& priceNode) {
-		os<<"[ " << priceNode.getPrice() << ", <";
-		for( auto& node : *priceNode.orderTree)
-			os << *node << ",";
+		os<<"[ " << priceText(priceNode.getPrice()) << ", <";
+		for(const OrderSlot* slot = priceNode.queue.front(); slot != NULL; slot = slot->next)
+			os << *slot->order << ",";
 		os << "> ]";
 		return os;
 	}
 
 
+	//one aggregated price level, what a depth query or an L2 feed sees
+	struct DepthLevel {
+		int price;
+		int orders;
+		int64_t quantity;
+
+		bool operator==(const DepthLevel& other) const {
+			return price == other.price && orders == other.orders && quantity == other.quantity;
+		}
+		bool operator!=(const DepthLevel& other) const { return !(*this == other); }
+	};
+
+	/*pre-trade limits of one trader in one book, 0 leaves a limit off.
+	open quantity counts every resting order of the trader, reserves
+	included, plus the incoming one. position is the net filled quantity if
+	every open order of the incoming order's side and the order itself
+	filled. notional is price x quantity of the order in ticks, a market
+	order is valued at the opposite best */
+	struct RiskLimits {
+		int maxOrderQty;
+		int64_t maxOpenQty;
+		int64_t maxPosition;
+		int64_t maxNotional;
+	};
+
+	//resting quantity of one trader in a book, reserves included
+	struct OpenQuantity {
+		int64_t buy;
+		int64_t sell;
+	};
+
+	//the uncross of a call auction, see OrderBook::findEquilibrium
+	struct AuctionResult {
+		int price;
+		int64_t volume; //executed at price
+		int64_t surplus; //demand - supply at price, what stays unmatched
+	};
+
+	/*self-trade prevention, what happens when an incoming order would trade
+	with a resting order of its own trader. checked in the sweep, one compare
+	of the interned TraderId per quote it reaches
+	STP_CANCEL_NEWEST : the rest of the incoming order is cancelled
+	STP_CANCEL_OLDEST : the resting order is cancelled, the sweep goes on
+	STP_CANCEL_BOTH : both are cancelled
+	STP_DECREMENT : both lose the smaller of the two quantities, so the
+	smaller one is cancelled and the other one goes on with what is left */
+	enum StpMode {
+		STP_NONE,
+		STP_CANCEL_NEWEST,
+		STP_CANCEL_OLDEST,
+		STP_CANCEL_BOTH,
+		STP_DECREMENT
+	};
+
+	/*per book settings. converts from a PriorityPolicy so a book
+	can still be built from its queue priority alone */
+	struct BookConfig {
+		PriorityPolicy priority;
+		LadderType ladder;
+		//ARRAY_LADDER only : lowest price held and the number of ticks above it
+		int basePrice;
+		int numTicks;
+		//pools are preallocated for this many resting orders and price levels
+		int orderCapacity;
+		int levelCapacity;
+		//PRO_RATA and PRO_RATA_TOP only : a share below this is rounded down to nothing
+		int minAllocation;
+		/*price collar, in ticks. a limit order priced further than this through
+		the opposite best is rejected. 0 : no collar */
+		int collar;
+		StpMode stp;
+
+		BookConfig(PriorityPolicy priority_ = PRICE_TIME, LadderType ladder_ = TREE_LADDER,
+			int basePrice_ = 0, int numTicks_ = 0) :
+		priority(priority_), ladder(ladder_), basePrice(basePrice_), numTicks(numTicks_),
+		orderCapacity(0), levelCapacity(0), minAllocation(1), collar(0), stp(STP_NONE) {}
+	};
+
+	/*what differs between a buy and a sell, fixed at compile time so the
+	sweep and the level insert are written once and each side still gets
+	its own code. Side is the side of the incoming order */
+	struct BuySide {
+		enum { isBuy = true };
+		//a limit at limitPrice takes a contra level at levelPrice
+		static bool crosses(int limitPrice, int levelPrice) { return limitPrice >= levelPrice; }
+		//price a is nearer the touch than b on the side's own ladder
+		static bool better(int a, int b) { return a > b; }
+	};
+	struct SellSide {
+		enum { isBuy = false };
+		static bool crosses(int limitPrice, int levelPrice) { return limitPrice <= levelPrice; }
+		static bool better(int a, int b) { return a < b; }
+	};
+
 	/*
 	Order book
 	*/
 	class OrderBook {
 	private:
+		/*every Order, PriceNode, OrderSlot and container node of the book
+		comes from these pools and goes back to them, so once they are reserved
+		to the working size add and match never call malloc/free */
+		NodeArena arena;
+		ObjectPool<Order> orderPool;
+		ObjectPool<PriceNode> levelPool;
+		ObjectPool<OrderSlot> slotPool;
+
 		/*
-		binary sorted tree (map) for indexing bid and ask
-		within order book
-		/* Advantages : add order - logN,
-		Modify : logN to 2logN (remove and add again)
-		Remove : logN
-		Trade : 2logN ~ 2 0(N) if all orders are of the same price, map will
-		degrade to a list
+		price ladders for indexing bid and ask within order book.
+		TREE_LADDER - binary sorted tree (map) plus a hashmap to find an existing
+		price in O(1) : new level logN, best level O(1), any price accepted.
+		ARRAY_LADDER - tick indexed array : new level O(1), best level O(1),
+		next level by a bitmap word scan, prices limited to the configured range.
 		*/
-		map<int, PriceNodePtr>* bidTree; //<price, LimitPriceNode>
-		map<int, PriceNodePtr>* askTree;
+		PriceLadder* bids;
+		PriceLadder* asks;
+		//best level of each side, NULL when empty. kept by add and eraseLevel
+		PriceNode* bestBid;
+		PriceNode* bestAsk;
+
+		/*for booking a trade : dense by trader id, O(1) with no hashing.
+		only traders registered through bookTradeForTrader are booked, the
+		ids the vector grew past stay unbooked. booked is the same size */
+		AccountMap account;
+		vector<uint8_t> booked;
+		/*pre-trade risk state, dense by trader id like account. open is kept
+		for every trader that ever rested an order, limits only for the ones
+		given some */
+		vector<OpenQuantity> open;
+		vector<RiskLimits> limits;
+		/*every resting order by id. ids are expected to be unique, a
+		duplicate id shadows the older order for cancel and amend */
+		OrderIndex orderIndex;
+
+		//queue priority of every price level in this book
+		PriorityPolicy priority;
+		BookConfig config;
+
+		//execution events go here, NULL when nobody listens
+		EventBuffer* events;
+		//bumped by every change to a level, market data compares it to skip idle books
+		uint64_t version;
 
-		/*for booking a trade
-		add and remove complexity is O(N) */
-		unordered_map<string, int>* account;
-		//hashmap to speed up add() in order book to O(1) if the price already exists
-		unordered_map<int, PriceNodePtr>* bidMap;
-		unordered_map<int, PriceNodePtr>* askMap;
+		/*trigger book. a buy stop fires once a trade prints at or above its
+		trigger, a sell stop at or below. the nearest trigger of each side is
+		cached so the check after a fill is two compares when nothing fires */
+		BuyStops buyStops;
+		SellStops sellStops;
+		int nearestBuyStop; //INT_MAX when there is none
+		int nearestSellStop; //INT_MIN when there is none
+		int lastTradePrice; //INAN before the first trade
+		//fired stops waiting to be executed, in firing order
+		vector<Order*> triggered;
+		size_t triggeredHead;
+		//call phase of an auction : orders rest without matching
+		bool auctionCall;
+		/*self-trade prevention during the current match : the quantity it took
+		off the incoming order and whether that ended the order */
+		int selfTradeQty;
+		bool selfTradeDone;
+
+	#ifdef MATCHING_STATS
+		BookStats stats;
+	#endif
 
 	public:
-		OrderBook();
+		OrderBook(const BookConfig& config = BookConfig());
 		virtual ~OrderBook();
 
-		void add(Order* order);
+		/*false when the ladder cannot hold the price, the caller keeps the order.
+		with peak > 0 the order is an iceberg showing at most peak at a time */
+		bool add(Order* order, int peak = 0);
+
+		/*orders handed to the book are owned by it from then on. they can be
+		allocated from the book pool, anything else is released with delete */
+		template<typename... Args>
+		Order* newOrder(Args&&... args) { return orderPool.create(std::forward<Args>(args)...); }
+		void releaseOrder(const Order* order);
+		/*releases an order that never rests: a price the ladder cannot hold
+		(add returned false) or the leaves of an IOC, FOK or market order */
+		void dropOrder(const Order* order, DoneReason reason = DONE_DROPPED);
 		void match(const Order* order, int& qtyToMatch);
-		void match(OrderTreeIt it, const Order* order, int& qtyToMatch, OrderTree* quotes, int bestPrice);
+		void match(PriceNode* level, const Order* order, int& qtyToMatch);
+		/*an incoming order : matches it, then posts the leaves of a limit order
+		and expires those of an IOC, FOK or market order. a FOK that cannot
+		fill completely is expired from the level aggregates before any queue
+		is touched. returns the quantity that did not fill. peak makes the
+		posted leaves an iceberg (see add) */
+		int execute(Order* order, int peak = 0);
+
+		PriceLadder* getBids() { return bids; }
+		PriceLadder* getAsks() { return asks; }
+		const PriceLadder* getBids() const { return bids; }
+		const PriceLadder* getAsks() const { return asks; }
 
-		PriceTree*& getBidTree() { return bidTree;}
-		PriceTree*& getAskTree() { return askTree;}
+		PriorityPolicy getPriority() const { return priority; }
+		const BookConfig& getConfig() const { return config; }
+		uint64_t getVersion() const { return version; }
 
-		PriceToNodeMap*& getAskMap() { return askMap;}
-		PriceToNodeMap*& getBidMap() { return bidMap;}
+		/*top of book and depth queries, for pre-trade checks and routing.
+		best prices and spread are O(1), INAN when a side is empty */
+		const PriceNode* getBestLevel(bool bidSide) const { return bidSide ? bestBid : bestAsk; }
+		int getBestBid() const { return bestBid != NULL ? bestBid->getPrice() : INAN; }
+		int getBestAsk() const { return bestAsk != NULL ? bestAsk->getPrice() : INAN; }
+		int getSpread() const {
+			return bestBid != NULL && bestAsk != NULL ? bestAsk->getPrice() - bestBid->getPrice() : INAN;
+		}
+		//resting quantity at exactly price, O(1)
+		int64_t quantityAt(bool bidSide, int price) const;
+		/*resting quantity of a side at limitPrice or better (bids at or above,
+		asks at or below), summed from the level aggregates. the walk stops
+		once enough is found, so a "would it fill" check costs the levels it
+		would sweep, never the orders */
+		int64_t quantityAvailableUpTo(bool bidSide, int limitPrice,
+			int64_t enough = numeric_limits<int64_t>::max()) const;
+		//true if an order of qty at limitPrice would fill completely on arrival
+		bool wouldFill(bool isBuy, int limitPrice, int qty) const {
+			return quantityAvailableUpTo(!isBuy, limitPrice, qty) >= qty;
+		}
+		/*same for an incoming order, a market order takes any price. with
+		self-trade prevention on, the order's own resting quantity does not
+		count, see selfFreeFill */
+		bool wouldFill(const Order* order) const {
+			int limit = order->price;
+			if(order->flags & ORDER_MARKET)
+				limit = order->isBuy() ? numeric_limits<int>::max() : numeric_limits<int>::min();
+			if(config.stp != STP_NONE && order->trader < open.size()
+				&& (order->isBuy() ? open[order->trader].sell : open[order->trader].buy) > 0)
+				return selfFreeFill(order, limit);
+			return wouldFill(order->isBuy(), limit, order->quantity);
+		}
+		/*the best n levels of a side into out, aggregated per level. O(n),
+		individual orders are never visited. n = 0 gives every level.
+		only the visible quantity is shown, a level holding nothing but
+		hidden quantity is skipped */
+		void getDepth(bool bidSide, size_t n, vector<DepthLevel>& out) const;
+		//grows the pools and the order index for a bulk load, like a restore
+		void reserve(size_t nOrders, size_t nLevels);
+
+		/*match, add and cancel append what they did to buffer (see events.h).
+		the caller owns the buffer and clears it between input messages */
+		void setEventBuffer(EventBuffer* buffer) { events = buffer; }
+		EventBuffer* getEventBuffer() const { return events; }
+
+	#ifdef MATCHING_STATS
+		//read from the thread that owns the book, or once it is idle
+		const BookStats& getStats() const { return stats; }
+		void clearStats() { stats.clear(); }
+	#endif
+
+		/*cancel and amend of resting orders, all found through orderIndex.
+		return false if no order rests with that id.
+		cancel : O(1), plus the level erase when it was the last order
+		reduce : takes qty off the order and keeps its queue priority, O(1)
+		for PRICE_TIME. reducing to zero or below cancels the order. an
+		iceberg gives up its reserve first, newQty of replace is its total
+		replace : a pure reduction at the same price is a reduce, anything else
+		loses priority - the order is pulled, matched at the new price and the
+		rest is posted at the back of its new level
+		*/
+		bool cancel(OrderId id);
+		bool reduce(OrderId id, int qty);
+		bool replace(OrderId id, int newPrice, int newQty);
+		const Order* findOrder(OrderId id) const;
+		//turns a resting order into an iceberg with that reserve, for a restore
+		bool setReserve(OrderId id, int peak, int reserve);
+
+		/*stop and stop-limit orders. the order rests in the trigger book
+		until the last trade reaches trigger, it then executes as a market
+		order (ORDER_MARKET) or a limit order at its price. false if the last
+		trade already reached trigger : the caller executes it at once.
+		cancel also finds stops, by a scan of the trigger book */
+		bool addStop(Order* order, int trigger);
+		/*next fired stop, NULL when none. stops fire by trigger price, nearest
+		first, buys before sells, and in arrival order for one trigger */
+		Order* popTriggered() {
+			if(triggeredHead < triggered.size())
+				return triggered[triggeredHead++];
+			triggered.clear();
+			triggeredHead = 0;
+			return NULL;
+		}
+		/*call auction. from beginAuction to uncross orders are only collected
+		and the book may cross : limit orders rest without matching, IOC, FOK
+		and market orders expire and stops wait. uncross trades every crossing
+		order at the equilibrium price in one pass, each side in price then
+		queue priority, and goes back to continuous matching. returns the
+		volume traded */
+		void beginAuction() { auctionCall = true; }
+		bool inAuction() const { return auctionCall; }
+		int64_t uncross();
+		/*the price executing the most volume, from the cumulative quantities
+		of the crossed levels, O(crossed levels) with no order visited. ties go
+		to the smallest surplus, then to the highest price when only buyers
+		are left over or the lowest when only sellers are, then to the price
+		nearest the last trade, then to the lowest. false if the book does not
+		cross. the indicative price during the call phase */
+		bool findEquilibrium(AuctionResult& result) const;
+		int getLastTradePrice() const { return lastTradePrice; }
+		size_t getStopCount() const { return buyStops.size() + sellStops.size(); }
+		const BuyStops& getBuyStops() const { return buyStops; }
+		const SellStops& getSellStops() const { return sellStops; }
+		//restores the last trade price, for a restore
+		void setLastTradePrice(int price) { lastTradePrice = price; }
 
 		/*marketable orders remove liquidity, the bid must be above the current ask
 		or the asks must be below the current bid.
 		*/
 		bool isMarketable(const Order* order, int bestPrice, bool isBuy);
 
-		void bookTrade(int execQty, const string& buyer, const string& seller);
+	private:
+		/*match and add pick the instantiation for the side of the order and
+		the ladder type of the book once per order, so the ladder calls made
+		per level are direct and inlined instead of virtual */
+		template<class Side, class Ladder>
+		void sweep(Ladder* contra, const Order* order, int& qtyToMatch);
+		//the level of price on the side's ladder, created if missing. NULL if the ladder cannot hold it
+		template<class Side, class Ladder>
+		PriceNode* levelFor(Ladder* ladder, int price);
+		/*one trade of execQty between order and the resting order of slot,
+		which shows less than execQty only when its reserve makes up the rest */
+		void fill(PriceNode* level, OrderSlot* slot, const Order* order, int execQty, int& qtyToMatch);
+		//slot rests for the trader of the incoming order, applies config.stp instead of a trade
+		void preventSelfTrade(PriceNode* level, OrderSlot* slot, const Order* order, int& qtyToMatch);
+		//the resting order of slot gave execQty to a trade
+		void consume(PriceNode* level, OrderSlot* slot, int execQty);
+		//pro-rata share of qtyToMatch at a level holding more than it
+		void allocate(PriceNode* level, const Order* order, int& qtyToMatch);
+		//unlinks a resting order and drops its level once it is empty
+		void unlinkOrder(OrderSlot* slot);
+		template<class Ladder>
+		void eraseLevel(Ladder* ladder, PriceNode* level);
+		PriceLadder* newLadder(const BookConfig& config, bool isBid);
+		void releaseSlot(OrderSlot* slot);
+		void unindex(const OrderSlot* slot);
+		//resting quantity of the order's trader and side moved by delta
+		void addOpen(const Order* order, int64_t delta) {
+			OpenQuantity& o = open[order->trader];
+			(order->isBuy() ? o.buy : o.sell) += delta;
+		}
+		//after a fill at lastTradePrice, O(1) unless a stop fires
+		void checkStops() {
+			if(lastTradePrice >= nearestBuyStop || lastTradePrice <= nearestSellStop)
+				fireStops();
+		}
+		void fireStops();
+		bool cancelStop(OrderId id);
+		//wouldFill of an order whose trader rests on the other side
+		bool selfFreeFill(const Order* order, int limitPrice) const;
+
+	public:
+
+		void bookTrade(int execQty, TraderId buyer, TraderId seller);
 		void bookTradeForTrader(const vector<string>& names);
-		int getTraderExposure(const string& name);
+		//same for an interned trader, never touches traderTable()
+		void bookTradeForTrader(TraderId trader);
+		int getTraderExposure(const string& name) const;
+		const AccountMap& getAccount() const { return account; }
+		bool isBooked(TraderId trader) const { return trader < booked.size() && booked[trader]; }
+		//restores an exposure, the trader is booked from then on
+		void setExposure(TraderId trader, int exposure);
+
+		/*limits checked before an incoming order matches or rests, the
+		trader is booked so its position is known. an order that breaks one
+		is rejected (EVENT_REJECTED) and released */
+		void setRiskLimits(TraderId trader, const RiskLimits& traderLimits);
+		OpenQuantity getOpenQuantity(TraderId trader) const {
+			OpenQuantity none = { 0, 0 };
+			return trader < open.size() ? open[trader] : none;
+		}
+		//0 when the order passes, a few compares against the dense arrays
+		int checkRisk(const Order* order) const;
 
 		friend ostream& operator<<(ostream& os, const OrderBook& book);
 	};
@@ -148,161 +511,392 @@ namespace Matching {
 
 		//better to display asking price in the opposite way
 		os << "\n------Ask------\n";
-		for(PriceTreeIt it = book.askTree->begin(); it != book.askTree->end(); ++it) {
-			os << "Price: " << it->first << " [ ";
-			for(const auto& order: *(it->second->getOrderTree()))
-				os << *order << " ";
+		for(const PriceNode* level = book.asks->best(); level != NULL; level = book.asks->next(level->getPrice())) {
+			os << "Price: " << priceText(level->getPrice()) << " [ ";
+			for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next)
+				os << *slot->order << " ";
 			os << " ]" << endl;
 		}
-		/*
-		os << "\n------Ask------\n";
-		for(PriceTreeRevIt it = book.askTree->rbegin(); it != book.askTree->rend(); ++it) {
-			os << "Price: " << it->first << " [ ";
-			for(const auto& order: *(it->second->getOrderTree()))
-				os << *order << " ";
-			os << " ]" << endl;
-		}*/
 
 		os << "\n------Bid------\n";
-		for(PriceTreeRevIt it = book.bidTree->rbegin(); it!= book.bidTree->rend(); ++it) {
-			os << "Price: " << it->first << " [ ";
-			for( const auto& order: *(it->second->getOrderTree()))
-				os << *order << " ";
+		for(const PriceNode* level = book.bids->best(); level != NULL; level = book.bids->next(level->getPrice())) {
+			os << "Price: " << priceText(level->getPrice()) << " [ ";
+			for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next)
+				os << *slot->order << " ";
 			os << " ]" << endl;
 		}
 		return os;
 	}
 
-	/* PriceNode */
-	inline void PriceNode::clean(){
-		for(OrderTreeIt it = orderTree->begin(); it != orderTree->end(); ++it) {
-			delete *it;
-		}
-		delete orderTree;
+	/* OrderBook */
+	inline PriceLadder* OrderBook::newLadder(const BookConfig& config, bool isBid) {
+		if(config.ladder == ARRAY_LADDER)
+			return new ArrayLadder(isBid, config.basePrice, config.numTicks);
+		return new TreeLadder(isBid, &arena, config.levelCapacity);
 	}
 
-	/* OrderBook */
-	inline OrderBook::OrderBook() {
-		bidTree = new PriceTree();
-		askTree = new PriceTree();
-		bidMap = new PriceToNodeMap();
-		askMap = new PriceToNodeMap();
-		account = new AccountMap();
+	inline OrderBook::OrderBook(const BookConfig& config) :
+	orderPool(config.orderCapacity), levelPool(config.levelCapacity),
+	slotPool(config.orderCapacity), bestBid(NULL), bestAsk(NULL),
+	orderIndex(0, OrderIndex::hasher(), OrderIndex::key_equal(), OrderIndex::allocator_type(&arena)),
+	priority(config.priority), config(config), events(NULL), version(0),
+	buyStops(less<int>(), StopAllocator(&arena)), sellStops(greater<int>(), StopAllocator(&arena)),
+	nearestBuyStop(numeric_limits<int>::max()), nearestSellStop(numeric_limits<int>::min()),
+	lastTradePrice(INAN), triggeredHead(0), auctionCall(false), selfTradeQty(0), selfTradeDone(false) {
+		//an empty book only holds its two ladder objects, every container
+		//allocates on first use unless a capacity is configured
+		bids = newLadder(config, true);
+		asks = newLadder(config, false);
+		if(config.orderCapacity > 0) {
+			orderIndex.reserve(config.orderCapacity);
+			prefaultNodes(orderIndex, config.orderCapacity);
+		}
 	}
 
 	inline OrderBook::~OrderBook() {
-		for(PriceTreeIt it = bidTree->begin(); it != bidTree->end(); ++it)
-			delete it->second;
-		for(PriceTreeIt it = askTree->begin(); it != askTree->end(); ++it)
-			delete it->second;
-
-		delete bidTree;
-		delete askTree;
-		delete bidMap;
-		delete askMap;
-		delete account;
+		PriceLadder* ladders[] = { bids, asks };
+		for(PriceLadder* ladder : ladders) {
+			for(PriceNode* level = ladder->best(); level != NULL; ) {
+				PriceNode* next = ladder->next(level->getPrice());
+				OrderQueue& quotes = level->getQueue();
+				while(!quotes.empty()) {
+					OrderSlot* slot = quotes.front();
+					quotes.unlink(slot);
+					releaseOrder(slot->order);
+					slotPool.destroy(slot);
+				}
+				levelPool.destroy(level);
+				level = next;
+			}
+			delete ladder;
+		}
+		for(BuyStops::iterator it = buyStops.begin(); it != buyStops.end(); ++it)
+			releaseOrder(it->second);
+		for(SellStops::iterator it = sellStops.begin(); it != sellStops.end(); ++it)
+			releaseOrder(it->second);
+		for(size_t i = triggeredHead; i < triggered.size(); ++i)
+			releaseOrder(triggered[i]);
 	}
 
-	inline bool OrderBook::isMarketable(const Order* order, int bestPrice, bool isBuy) {
-		if(isBuy)
-			return order->price >= bestPrice;
+	inline void OrderBook::releaseOrder(const Order* order) {
+		Order* o = const_cast<Order*>(order);
+		if(orderPool.owns(o))
+			orderPool.destroy(o);
 		else
-			return order->price <= bestPrice;
+			delete o;
 	}
 
-	/*Marketable order handling:
-	Remove liquidity to the other side of the book and order time: O(1) */
-	inline void OrderBook::match(const Order* order, int& qtyToMatch) {
-		bool isBuy = order->isBuy;
-		//get the opposite side of the tree to match
-		if(isBuy) {
-			//check the askTree
-			for(PriceTreeIt itBestPrice = askTree->begin();
-				itBestPrice != askTree->end() && isMarketable(order,askTree->begin()->first,order->isBuy) &&
-				qtyToMatch > 0; )
-			{
-				int bestPrice = itBestPrice->first;
-				PriceNode* bestPriceNode = itBestPrice->second;
-				OrderTree* quotes = bestPriceNode->getOrderTree();
-				//for each order (in size>time) in this price level
-				match(quotes->begin(), order, qtyToMatch, quotes, bestPrice);
-				//order depletes current price level
-				if(quotes->empty()) {
-					delete bestPriceNode;
-					//bestPriceNode = NULL;
-					//deals with the nodes in the trees only for that price level. when the quantity is changed
-					//for qtyToMatch, this is updated in the processOrder function, not here.
-					askTree->erase(itBestPrice++);
-					askMap->erase(bestPrice);
+	inline void OrderBook::reserve(size_t nOrders, size_t nLevels) {
+		orderPool.reserve(nOrders);
+		slotPool.reserve(nOrders);
+		levelPool.reserve(nLevels);
+		orderIndex.reserve(nOrders);
+	}
+
+	inline void OrderBook::getDepth(bool bidSide, size_t n, vector<DepthLevel>& out) const {
+		out.clear();
+		const PriceLadder* ladder = bidSide ? bids : asks;
+		for(const PriceNode* level = getBestLevel(bidSide); level != NULL && (n == 0 || out.size() < n);
+			level = ladder->next(level->getPrice())) {
+			if(level->getVisibleQuantity() == 0)
+				continue;
+			DepthLevel d = { level->getPrice(), level->getVisibleOrderCount(), level->getVisibleQuantity() };
+			out.push_back(d);
+		}
+	}
+
+	inline int64_t OrderBook::quantityAt(bool bidSide, int price) const {
+		const PriceNode* level = (bidSide ? bids : asks)->find(price);
+		return level != NULL ? level->getQuantity() : 0;
+	}
+
+	inline int64_t OrderBook::quantityAvailableUpTo(bool bidSide, int limitPrice, int64_t enough) const {
+		const PriceLadder* ladder = bidSide ? bids : asks;
+		int64_t total = 0;
+		for(const PriceNode* level = bidSide ? bestBid : bestAsk; level != NULL && total < enough;
+			level = ladder->next(level->getPrice())) {
+			if(bidSide ? level->getPrice() < limitPrice : level->getPrice() > limitPrice)
+				break;
+			total += level->getQuantity();
+		}
+		return total;
+	}
+
+	/*walks the orders of the levels it reaches, so only used when the trader
+	has something resting on the other side. STP_CANCEL_OLDEST takes the own
+	quotes out and the sweep goes on, so they just do not count. any other mode
+	cuts the incoming order short at the first own quote it reaches, so the
+	order fills only if enough comes before that one. a pro-rata level hands
+	shares to every order at once, an own order anywhere in it counts as
+	reached */
+	inline bool OrderBook::selfFreeFill(const Order* order, int limitPrice) const {
+		bool bidSide = !order->isBuy();
+		const PriceLadder* ladder = bidSide ? bids : asks;
+		bool inOrder = priority == PRICE_TIME || priority == SIZE_TIME || config.stp == STP_CANCEL_OLDEST;
+		int64_t need = order->quantity;
+		int64_t total = 0;
+		for(const PriceNode* level = bidSide ? bestBid : bestAsk; level != NULL;
+			level = ladder->next(level->getPrice())) {
+			if(bidSide ? level->getPrice() < limitPrice : level->getPrice() > limitPrice)
+				break;
+			//shown quantity in queue order, an iceberg refills at the back
+			int64_t shown = total;
+			int64_t own = 0;
+			for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next) {
+				if(slot->order->trader != order->trader) {
+					shown += slot->order->quantity;
+					if(inOrder && shown >= need)
+						return true;
 				}
+				else if(config.stp == STP_CANCEL_OLDEST)
+					own += slot->order->quantity + slot->reserve;
 				else
-					++itBestPrice;
+					return false;
 			}
+			total += level->getQuantity() - own;
+			if(total >= need)
+				return true;
+		}
+		return false;
+	}
+
+	inline void OrderBook::dropOrder(const Order* order, DoneReason reason) {
+		if(events)
+			emitEvent(events, EVENT_DONE, order, order->quantity, 0, reason);
+		releaseOrder(order);
+	}
+
+	inline void OrderBook::releaseSlot(OrderSlot* slot) {
+		releaseOrder(slot->order);
+		slotPool.destroy(slot);
+	}
+
+	inline bool OrderBook::isMarketable(const Order* order, int bestPrice, bool isBuy) {
+		if(order->flags & ORDER_MARKET)
+			return true;
+		return isBuy ? BuySide::crosses(order->price, bestPrice) : SellSide::crosses(order->price, bestPrice);
+	}
+
+	/*Marketable order handling:
+	Remove liquidity to the other side of the book and order time: O(1) */
+	inline void OrderBook::match(const Order* order, int& qtyToMatch) {
+		BOOK_STATS(uint64_t start = statsNow(); ++stats.orders;)
+		bool isBuy = order->isBuy();
+		int openQty = qtyToMatch;
+		selfTradeQty = 0;
+		selfTradeDone = false;
+		if(events)
+			emitEvent(events, EVENT_ACCEPTED, order, order->quantity, openQty);
+		//sweep the opposite side of the book
+		if(config.ladder == ARRAY_LADDER) {
+			if(isBuy)
+				sweep<BuySide>(static_cast<ArrayLadder*>(asks), order, qtyToMatch);
+			else
+				sweep<SellSide>(static_cast<ArrayLadder*>(bids), order, qtyToMatch);
 		}
 		else {
-			for(PriceTreeRevIt itBestPrice = bidTree->rbegin();
-				itBestPrice != bidTree->rend() && 
-				isMarketable(order,bidTree->rbegin()->first,order->isBuy) &&
-				qtyToMatch > 0; ) {
-				int bestPrice = itBestPrice->first;
-				PriceNode* bestPriceNode = itBestPrice->second;
-				OrderTree* quotes = bestPriceNode->getOrderTree();
-
-				//for each order for(size>time) in this price level
-				match(quotes->begin(),order,qtyToMatch,quotes,bestPrice);
-
-				//order depeltes current price level
-				if(quotes->empty()) {
-					delete bestPriceNode;
-					bidTree->erase(std::next(itBestPrice).base()); //erase in reverse iterator
-					bidMap->erase(bestPrice);
-				}
-				else {
-					++itBestPrice;
-				}
-			}
+			if(isBuy)
+				sweep<BuySide>(static_cast<TreeLadder*>(asks), order, qtyToMatch);
+			else
+				sweep<SellSide>(static_cast<TreeLadder*>(bids), order, qtyToMatch);
+		}
+
+		if(events && qtyToMatch < openQty) {
+			if(qtyToMatch == 0)
+				emitEvent(events, EVENT_DONE, order, order->quantity, 0, selfTradeDone ? DONE_SELF_TRADE : DONE_FILLED);
+			else if(qtyToMatch + selfTradeQty < openQty)
+				emitEvent(events, EVENT_PARTIAL_FILL, order, order->quantity, qtyToMatch);
+		}
+		//fully filled orders never rest, the book owns and frees them
+		if(qtyToMatch == 0)
+			releaseOrder(order);
+		BOOK_STATS(stats.matchLatency.record(statsNow() - start);)
+	}
+
+	template<class Side, class Ladder>
+	inline void OrderBook::sweep(Ladder* contra, const Order* order, int& qtyToMatch) {
+		PriceNode*& best = Side::isBuy ? bestAsk : bestBid;
+		bool anyPrice = order->flags & ORDER_MARKET;
+		while(qtyToMatch > 0 && best != NULL && (anyPrice || Side::crosses(order->price, best->getPrice()))) {
+			PriceNode* level = best;
+			//for each order (in queue priority) in this price level
+			BOOK_STATS(++stats.levelsSwept;)
+			match(level, order, qtyToMatch);
+			//order depletes current price level
+			if(level->empty())
+				eraseLevel(contra, level);
 		}
 	}
 
 		/*the overloaded match function which is called for each
 		order of the price level. it satisfies full or a part of the requiremtn
-		for buy/sell. the quantity of shares is also reduced here. the results 
-		go up to match 1 and deletion or it moves to the next BestPrice
+		for buy/sell, always from the head of the level queue. a partial fill
+		leaves the quote at the head with its quantity reduced (SIZE_TIME moves it
+		back to its new place), a full fill unlinks it in O(1).
+		a pro-rata book first shares out an order smaller than the level, the
+		lots left by the rounding then go from the head the same way.
 		*/
+		inline void OrderBook::match(PriceNode* level, const Order* order, int& qtyToMatch) {
+			OrderQueue& quotes = level->getQueue();
+			++version;
+			if((priority == PRO_RATA || priority == PRO_RATA_TOP) && qtyToMatch < level->getQuantity())
+				allocate(level, order, qtyToMatch);
 
-		inline void OrderBook::match(OrderTreeIt it, const Order* order, int& qtyToMatch, OrderTree* quotes, int bestPrice) {
-			//it is the OrderTree which has many orders of the same price
-			bool isBuy = order->isBuy;
-
-			while(it != quotes->end() &&
-				order != NULL &&
-				isMarketable(order,bestPrice,isBuy) &&
-				qtyToMatch > 0) {
-				Order* quote = *it;
-				//we're matching this quote, so remove this from the quotes (opposite)
-				quotes->erase(it++);
-
-				int curQty = quote->quantity;
-				int execQty = min(curQty,qtyToMatch); //it is possible that the ask volume is greater than the one desired
-				const string& buyer = isBuy ? order->name : quote->name;
-				const string& seller = isBuy ? quote->name : order->name;
-				bookTrade(execQty,buyer,seller);
-				qtyToMatch -= execQty;
-
-				//add residual back to order tree
-				if(curQty > execQty) {
-					quote->quantity = curQty - execQty;
-					quotes->emplace(quote);
-				}
-				else
-				{
-					delete quote;
-				}
+			while(!quotes.empty() && qtyToMatch > 0) {
+				OrderSlot* slot = quotes.front();
+				//it is possible that the ask volume is greater than the one desired
+				fill(level, slot, order, min(slot->order->quantity, qtyToMatch), qtyToMatch);
+			}
+			//a level can be left by self-trade prevention alone
+			if(lastTradePrice == level->getPrice())
+				checkStops();
+		}
 
+		inline void OrderBook::fill(PriceNode* level, OrderSlot* slot, const Order* order, int execQty, int& qtyToMatch) {
+			Order* quote = slot->order;
+			if(quote->trader == order->trader && config.stp != STP_NONE) {
+				preventSelfTrade(level, slot, order, qtyToMatch);
+				return;
 			}
+			lastTradePrice = level->getPrice();
+			TraderId buyer = order->isBuy() ? order->trader : quote->trader;
+			TraderId seller = order->isBuy() ? quote->trader : order->trader;
+			bookTrade(execQty,buyer,seller);
+			qtyToMatch -= execQty;
+			BOOK_STATS(++stats.fills;)
+			if(events) {
+				ExecEvent& e = events->push();
+				e.type = EVENT_TRADE;
+				e.reason = 0;
+				e.flags = order->flags;
+				e.symbol = order->symbol;
+				e.trader = order->trader;
+				e.contraTrader = quote->trader;
+				e.id = order->id;
+				e.contraId = quote->id;
+				e.price = level->getPrice();
+				e.quantity = execQty;
+				e.leaves = qtyToMatch;
+			}
+			consume(level, slot, execQty);
+		}
 
-			if(qtyToMatch == 0) {
-				delete order;
+		/*no event for the trade that did not happen. an order that is cancelled
+		or decremented to nothing gets EVENT_DONE with DONE_SELF_TRADE, the
+		incoming one from match, one that goes on gets EVENT_DECREMENTED.
+		the level is never erased here, the sweep does it once it is empty */
+		inline void OrderBook::preventSelfTrade(PriceNode* level, OrderSlot* slot, const Order* order, int& qtyToMatch) {
+			Order* quote = slot->order;
+			int resting = quote->quantity + slot->reserve;
+			int fromOrder = 0, fromQuote = 0;
+			switch(config.stp) {
+			case STP_CANCEL_NEWEST:
+				fromOrder = qtyToMatch;
+				break;
+			case STP_CANCEL_OLDEST:
+				fromQuote = resting;
+				break;
+			case STP_CANCEL_BOTH:
+				fromOrder = qtyToMatch;
+				fromQuote = resting;
+				break;
+			default:
+				fromOrder = fromQuote = min(resting, qtyToMatch);
+				break;
+			}
+			BOOK_STATS(++stats.selfTrades;)
+			qtyToMatch -= fromOrder;
+			selfTradeQty += fromOrder;
+			if(qtyToMatch == 0)
+				selfTradeDone = true;
+			else if(events && fromOrder > 0)
+				emitEvent(events, EVENT_DECREMENTED, order, fromOrder, qtyToMatch);
+
+			if(fromQuote == resting) {
+				if(events)
+					emitEvent(events, EVENT_DONE, quote, quote->quantity, 0, DONE_SELF_TRADE);
+				level->removeOrder(slot);
+				addOpen(quote, -resting);
+				unindex(slot);
+				releaseSlot(slot);
+			}
+			else if(fromQuote > 0) {
+				//like reduce, an iceberg gives up its reserve first
+				int fromReserve = min(fromQuote, slot->reserve);
+				level->takeReserve(slot, fromReserve);
+				quote->quantity -= fromQuote - fromReserve;
+				level->addQuantity(slot, fromReserve - fromQuote);
+				addOpen(quote, -fromQuote);
+				if(events)
+					emitEvent(events, EVENT_DECREMENTED, quote, fromQuote, resting - fromQuote);
+				level->getQueue().reposition(slot, priority);
+			}
+		}
+
+		inline void OrderBook::consume(PriceNode* level, OrderSlot* slot, int execQty) {
+			Order* quote = slot->order;
+			//a pro-rata share can reach into an iceberg's reserve
+			int fromReserve = max(execQty - quote->quantity, 0);
+			if(fromReserve > 0)
+				level->takeReserve(slot, fromReserve);
+			int curQty = quote->quantity;
+			int shownQty = execQty - fromReserve;
+			level->addQuantity(slot, -shownQty);
+			addOpen(quote, -execQty);
+
+			//residual stays in the queue
+			if(curQty > shownQty) {
+				quote->quantity = curQty - shownQty;
+				if(events)
+					emitEvent(events, EVENT_PARTIAL_FILL, quote, quote->quantity, quote->quantity + slot->reserve);
+				level->getQueue().reposition(slot, priority);
+			}
+			else if(slot->reserve > 0) {
+				level->replenish(slot, priority);
+				if(events)
+					emitEvent(events, EVENT_PARTIAL_FILL, quote, quote->quantity, quote->quantity + slot->reserve);
+			}
+			else
+			{
+				if(events)
+					emitEvent(events, EVENT_DONE, quote, curQty, 0, DONE_FILLED);
+				quote->quantity = 0;
+				level->removeOrder(slot);
+				unindex(slot);
+				releaseSlot(slot);
+			}
+		}
+
+		/*one walk of the queue in time order. PRO_RATA_TOP first fills the
+		front order (its shown quantity). every order then gets
+		floor(incoming * its quantity / level quantity), reserve included, taken
+		from the level aggregate before the walk. a share below minAllocation
+		is nothing. the shares never add up to more than the incoming quantity
+		nor exceed an order, what the rounding leaves is for the caller's
+		FIFO pass. an iceberg sent to the back by its fill is not served twice */
+		inline void OrderBook::allocate(PriceNode* level, const Order* order, int& qtyToMatch) {
+			OrderQueue& quotes = level->getQueue();
+			if(priority == PRO_RATA_TOP) {
+				OrderSlot* top = quotes.front();
+				fill(level, top, order, min(top->order->quantity, qtyToMatch), qtyToMatch);
+			}
+			int64_t levelQty = level->getQuantity();
+			int64_t incoming = qtyToMatch;
+			if(incoming == 0 || levelQty == 0)
+				return;
+			int minShare = max(config.minAllocation, 1);
+			OrderSlot* last = quotes.back();
+			for(OrderSlot* slot = quotes.front(); slot != NULL && qtyToMatch > 0; ) {
+				OrderSlot* next = slot->next;
+				bool end = slot == last;
+				int share = (int)(incoming * (slot->order->quantity + slot->reserve) / levelQty);
+				//self-trade prevention can take off more than the shares so far
+				share = min(share, qtyToMatch);
+				if(share >= minShare)
+					fill(level, slot, order, share, qtyToMatch);
+				if(end)
+					break;
+				slot = next;
 			}
 		}
 
@@ -310,52 +904,433 @@ namespace Matching {
 
 
 
+		inline int OrderBook::execute(Order* order, int peak) {
+			int qtyToMatch = order->quantity;
+			int rejected = checkRisk(order);
+			if(rejected != 0) {
+				if(events)
+					emitEvent(events, EVENT_REJECTED, order, order->quantity, 0, rejected);
+				releaseOrder(order);
+				return qtyToMatch;
+			}
+			if(auctionCall) {
+				if(events)
+					emitEvent(events, EVENT_ACCEPTED, order, order->quantity, qtyToMatch);
+				if(order->flags & ORDER_TIF_MASK)
+					dropOrder(order, DONE_EXPIRED);
+				else if(!add(order, peak))
+					dropOrder(order);
+				return qtyToMatch;
+			}
+			if((order->flags & ORDER_FOK) && !wouldFill(order)) {
+				if(events)
+					emitEvent(events, EVENT_ACCEPTED, order, order->quantity, qtyToMatch);
+				dropOrder(order, DONE_EXPIRED);
+				return qtyToMatch;
+			}
+			match(order, qtyToMatch);
+			//post non marketable portion
+			if(qtyToMatch > 0) {
+				order->quantity = qtyToMatch;
+				if(order->flags & ORDER_TIF_MASK)
+					dropOrder(order, DONE_EXPIRED);
+				//the ladder cannot hold the price, drop the remainder
+				else if(!add(order, peak))
+					dropOrder(order);
+			}
+			//what self-trade prevention took off did not fill either
+			return qtyToMatch + selfTradeQty;
+		}
+
 		/*Non marketable order handling :
 		Add liquidity to the same side of the book and order
-		time : O(1) if level exists, else O(logM) - M = avg number of quotes
+		time : O(1) if level exists, else O(logM) for the tree - M = avg number of quotes,
+		O(1) for the array ladder
 		*/
-		inline void OrderBook::add(Order* order) {
-			bool isBuy = order->isBuy;
+		inline bool OrderBook::add(Order* order, int peak) {
+			BOOK_STATS(uint64_t start = statsNow();)
 			int price = order->price;
-			PriceTree* priceTree = isBuy ? bidTree : askTree;
-			PriceToNodeMap* priceToNodeMap = isBuy ? bidMap : askMap;
+			//for searching, the ladder finds the PriceNode associated with
+			//that price if it exists and we add this new order to its queue
+			PriceNode* priceNode;
+			if(config.ladder == ARRAY_LADDER)
+				priceNode = order->isBuy() ? levelFor<BuySide>(static_cast<ArrayLadder*>(bids), price) :
+					levelFor<SellSide>(static_cast<ArrayLadder*>(asks), price);
+			else
+				priceNode = order->isBuy() ? levelFor<BuySide>(static_cast<TreeLadder*>(bids), price) :
+					levelFor<SellSide>(static_cast<TreeLadder*>(asks), price);
+			if(priceNode == NULL)
+				return false;
+			OrderSlot* slot = slotPool.create(order, priceNode);
+			if(peak > 0) {
+				slot->peak = peak;
+				slot->reserve = max(order->quantity - peak, 0);
+				order->quantity -= slot->reserve;
+			}
+			priceNode->insertOrder(slot, priority);
+			orderIndex[order->id] = slot;
+			if(order->trader >= open.size()) {
+				OpenQuantity none = { 0, 0 };
+				open.resize(order->trader + 1, none);
+			}
+			addOpen(order, order->quantity + slot->reserve);
+			++version;
+			BOOK_STATS(
+				if((uint64_t)priceNode->getQueue().size() > stats.maxQueueDepth)
+					stats.maxQueueDepth = priceNode->getQueue().size();
+			)
+			if(events)
+				emitEvent(events, EVENT_RESTED, order, order->quantity, order->quantity + slot->reserve);
+			BOOK_STATS(stats.addLatency.record(statsNow() - start);)
+			return true;
+		}
+
+		template<class Side, class Ladder>
+		inline PriceNode* OrderBook::levelFor(Ladder* ladder, int price) {
+			if(!ladder->accepts(price))
+				return NULL;
+			PriceNode* level = ladder->find(price);
+			if(level == NULL) {
+				level = levelPool.create(price, &arena);
+				ladder->insert(price, level);
+				PriceNode*& best = Side::isBuy ? bestBid : bestAsk;
+				if(best == NULL || Side::better(price, best->getPrice()))
+					best = level;
+				BOOK_STATS(++stats.levelsCreated;)
+			}
+			return level;
+		}
+
+		inline void OrderBook::unindex(const OrderSlot* slot) {
+			OrderIndexIt it = orderIndex.find(slot->order->id);
+			if(it != orderIndex.end() && it->second == slot)
+				orderIndex.erase(it);
+		}
 
-			PriceToNodeMapIt it = priceToNodeMap->find(price);
-			//for searching, the unordered_map helps, if the price exists
-			//we find the PriceNode associated with that price and add this new
-			//order to the OrderTree
-			if(it != priceToNodeMap->end()) {
-				OrderTree* quotes = it->second->getOrderTree();
-				quotes->emplace(order);
+		template<class Ladder>
+		inline void OrderBook::eraseLevel(Ladder* ladder, PriceNode* level) {
+			ladder->erase(level->getPrice());
+			PriceNode*& best = ladder->bidSide() ? bestBid : bestAsk;
+			if(best == level)
+				best = ladder->best();
+			levelPool.destroy(level);
+			BOOK_STATS(++stats.levelsDestroyed;)
+		}
+
+		inline void OrderBook::unlinkOrder(OrderSlot* slot) {
+			PriceNode* level = slot->level;
+			level->removeOrder(slot);
+			addOpen(slot->order, -(int64_t)(slot->order->quantity + slot->reserve));
+			++version;
+			unindex(slot);
+			if(level->empty())
+				eraseLevel(slot->order->isBuy() ? bids : asks, level);
+		}
+
+		inline const Order* OrderBook::findOrder(OrderId id) const {
+			OrderIndexConstIt it = orderIndex.find(id);
+			return it != orderIndex.end() ? it->second->order : NULL;
+		}
+
+		inline bool OrderBook::setReserve(OrderId id, int peak, int reserve) {
+			OrderIndexIt it = orderIndex.find(id);
+			if(it == orderIndex.end() || peak <= 0 || reserve < 0)
+				return false;
+			OrderSlot* slot = it->second;
+			//the slot keeps its place in the queue
+			slot->peak = peak;
+			addOpen(slot->order, reserve - slot->reserve);
+			slot->level->takeReserve(slot, slot->reserve - reserve);
+			++version;
+			return true;
+		}
+
+		inline bool OrderBook::addStop(Order* order, int trigger) {
+			if(order->isBuy()) {
+				if(lastTradePrice != INAN && lastTradePrice >= trigger)
+					return false;
+				buyStops.emplace(trigger, order);
+				nearestBuyStop = min(nearestBuyStop, trigger);
 			}
 			else {
-				PriceNode* priceNode = new PriceNode(price);
-				priceNode->insertOrder(order);
-				priceTree->emplace(price,priceNode);
-				priceToNodeMap->emplace(price, priceNode);
+				if(lastTradePrice != INAN && lastTradePrice <= trigger)
+					return false;
+				sellStops.emplace(trigger, order);
+				nearestSellStop = max(nearestSellStop, trigger);
 			}
+			return true;
 		}
 
-		inline void OrderBook::bookTrade(int qty, const string& buyer, const string& seller) {
-			AccountMapIt it = account->find(buyer);
-			if(it != account->end())
-				it->second += qty;
-			it = account->find(seller);
-			if(it != account->end())
-				it->second -= qty;
+		inline void OrderBook::fireStops() {
+			BuyStops::iterator buy = buyStops.begin();
+			for(; buy != buyStops.end() && buy->first <= lastTradePrice; ++buy)
+				triggered.push_back(buy->second);
+			buyStops.erase(buyStops.begin(), buy);
+			nearestBuyStop = buyStops.empty() ? numeric_limits<int>::max() : buyStops.begin()->first;
+			SellStops::iterator sell = sellStops.begin();
+			for(; sell != sellStops.end() && sell->first >= lastTradePrice; ++sell)
+				triggered.push_back(sell->second);
+			sellStops.erase(sellStops.begin(), sell);
+			nearestSellStop = sellStops.empty() ? numeric_limits<int>::min() : sellStops.begin()->first;
+		}
+
+		inline bool OrderBook::findEquilibrium(AuctionResult& result) const {
+			if(bestBid == NULL || bestAsk == NULL || bestBid->getPrice() < bestAsk->getPrice())
+				return false;
+			int low = bestAsk->getPrice(), high = bestBid->getPrice();
+			//every candidate price is a crossed level, bids come best (highest) first
+			vector<const PriceNode*> bidLevels, askLevels;
+			int64_t demand = 0;
+			for(const PriceNode* level = bestBid; level != NULL && level->getPrice() >= low; level = bids->next(level->getPrice())) {
+				bidLevels.push_back(level);
+				demand += level->getQuantity();
+			}
+			for(const PriceNode* level = bestAsk; level != NULL && level->getPrice() <= high; level = asks->next(level->getPrice()))
+				askLevels.push_back(level);
+
+			//up the candidates in price order : demand falls as the bids below
+			//the price drop out, supply grows as the asks at it come in
+			vector<AuctionResult> candidates;
+			size_t b = bidLevels.size(), a = 0;
+			int64_t supply = 0;
+			while(b > 0 || a < askLevels.size()) {
+				int price = a == askLevels.size() || (b > 0 && bidLevels[b - 1]->getPrice() < askLevels[a]->getPrice()) ?
+					bidLevels[b - 1]->getPrice() : askLevels[a]->getPrice();
+				if(a < askLevels.size() && askLevels[a]->getPrice() == price)
+					supply += askLevels[a++]->getQuantity();
+				AuctionResult candidate = { price, min(demand, supply), demand - supply };
+				candidates.push_back(candidate);
+				if(b > 0 && bidLevels[b - 1]->getPrice() == price)
+					demand -= bidLevels[--b]->getQuantity();
+			}
+
+			int64_t volume = 0, surplus = numeric_limits<int64_t>::max();
+			for(size_t i = 0; i < candidates.size(); ++i)
+				volume = max(volume, candidates[i].volume);
+			bool buyers = true, sellers = true;
+			for(size_t i = 0; i < candidates.size(); ++i)
+				if(candidates[i].volume == volume)
+					surplus = min(surplus, abs(candidates[i].surplus));
+			for(size_t i = 0; i < candidates.size(); ++i)
+				if(candidates[i].volume == volume && abs(candidates[i].surplus) == surplus) {
+					buyers = buyers && candidates[i].surplus > 0;
+					sellers = sellers && candidates[i].surplus < 0;
+				}
+			//candidates go up in price : buyers left over keep the last (highest),
+			//sellers and no reference the first (lowest)
+			bool found = false;
+			for(size_t i = 0; i < candidates.size(); ++i) {
+				const AuctionResult& c = candidates[i];
+				if(c.volume != volume || abs(c.surplus) != surplus)
+					continue;
+				if(!found || buyers)
+					result = c;
+				else if(!sellers && IS_VALID(lastTradePrice) &&
+					abs((int64_t)c.price - lastTradePrice) < abs((int64_t)result.price - lastTradePrice))
+					result = c;
+				found = true;
+			}
+			return found;
+		}
+
+		inline int64_t OrderBook::uncross() {
+			auctionCall = false;
+			AuctionResult result;
+			if(!findEquilibrium(result))
+				return 0;
+			//bestBid and bestAsk stay at or through the price until the volume is done
+			for(int64_t remaining = result.volume; remaining > 0; ) {
+				PriceNode* bidLevel = bestBid;
+				PriceNode* askLevel = bestAsk;
+				OrderSlot* bid = bidLevel->getQueue().front();
+				OrderSlot* ask = askLevel->getQueue().front();
+				int qty = (int)min<int64_t>(min(bid->order->quantity, ask->order->quantity), remaining);
+				remaining -= qty;
+				bookTrade(qty, bid->order->trader, ask->order->trader);
+				BOOK_STATS(++stats.fills;)
+				if(events) {
+					ExecEvent& e = events->push();
+					e.type = EVENT_TRADE;
+					e.reason = 0;
+					e.flags = bid->order->flags;
+					e.symbol = bid->order->symbol;
+					e.trader = bid->order->trader;
+					e.contraTrader = ask->order->trader;
+					e.id = bid->order->id;
+					e.contraId = ask->order->id;
+					e.price = result.price;
+					e.quantity = qty;
+					e.leaves = bid->order->quantity + bid->reserve - qty;
+				}
+				consume(bidLevel, bid, qty);
+				consume(askLevel, ask, qty);
+				if(bidLevel->empty())
+					eraseLevel(bids, bidLevel);
+				if(askLevel->empty())
+					eraseLevel(asks, askLevel);
+			}
+			++version;
+			lastTradePrice = result.price;
+			checkStops();
+			return result.volume;
+		}
+
+		inline bool OrderBook::cancelStop(OrderId id) {
+			for(BuyStops::iterator it = buyStops.begin(); it != buyStops.end(); ++it) {
+				if(it->second->id != id)
+					continue;
+				if(events)
+					emitEvent(events, EVENT_DONE, it->second, it->second->quantity, 0, DONE_CANCELLED);
+				releaseOrder(it->second);
+				buyStops.erase(it);
+				nearestBuyStop = buyStops.empty() ? numeric_limits<int>::max() : buyStops.begin()->first;
+				return true;
+			}
+			for(SellStops::iterator it = sellStops.begin(); it != sellStops.end(); ++it) {
+				if(it->second->id != id)
+					continue;
+				if(events)
+					emitEvent(events, EVENT_DONE, it->second, it->second->quantity, 0, DONE_CANCELLED);
+				releaseOrder(it->second);
+				sellStops.erase(it);
+				nearestSellStop = sellStops.empty() ? numeric_limits<int>::min() : sellStops.begin()->first;
+				return true;
+			}
+			return false;
+		}
+
+		inline bool OrderBook::cancel(OrderId id) {
+			BOOK_STATS(uint64_t start = statsNow(); ++stats.cancels;)
+			OrderIndexIt it = orderIndex.find(id);
+			if(it == orderIndex.end())
+				return (!buyStops.empty() || !sellStops.empty()) && cancelStop(id);
+			OrderSlot* slot = it->second;
+			if(events)
+				emitEvent(events, EVENT_DONE, slot->order, slot->order->quantity, 0, DONE_CANCELLED);
+			unlinkOrder(slot);
+			releaseSlot(slot);
+			BOOK_STATS(stats.cancelLatency.record(statsNow() - start);)
+			return true;
+		}
+
+		inline bool OrderBook::reduce(OrderId id, int qty) {
+			BOOK_STATS(++stats.amends;)
+			if(qty < 0)
+				return false;
+			OrderIndexIt it = orderIndex.find(id);
+			if(it == orderIndex.end())
+				return false;
+			OrderSlot* slot = it->second;
+			if(slot->order->quantity + slot->reserve <= qty)
+				return cancel(id);
+			//an iceberg gives up its reserve first
+			int fromReserve = min(qty, slot->reserve);
+			slot->level->takeReserve(slot, fromReserve);
+			slot->order->quantity -= qty - fromReserve;
+			slot->level->addQuantity(slot, fromReserve - qty);
+			addOpen(slot->order, -qty);
+			++version;
+			slot->level->getQueue().reposition(slot, priority);
+			return true;
+		}
+
+		inline bool OrderBook::replace(OrderId id, int newPrice, int newQty) {
+			BOOK_STATS(++stats.amends;)
+			OrderIndexIt it = orderIndex.find(id);
+			if(it == orderIndex.end())
+				return false;
+			OrderSlot* slot = it->second;
+			Order* order = slot->order;
+			if(newQty <= 0)
+				return cancel(id);
+			int total = order->quantity + slot->reserve;
+			if(newPrice == order->price && newQty <= total)
+				return reduce(id, total - newQty);
+
+			//an iceberg stays one with the same peak
+			int peak = slot->peak;
+			unlinkOrder(slot);
+			slotPool.destroy(slot);
+			order->price = newPrice;
+			order->quantity = newQty;
+			//outside the ladder range the remainder is dropped
+			execute(order, peak);
+			return true;
+		}
+
+		inline int OrderBook::checkRisk(const Order* order) const {
+			bool isBuy = order->isBuy();
+			bool market = order->flags & ORDER_MARKET;
+			//the book is crossed on purpose during the call phase
+			if(config.collar > 0 && !market && !auctionCall) {
+				if(isBuy ? bestAsk != NULL && order->price > bestAsk->getPrice() + config.collar :
+					bestBid != NULL && order->price < bestBid->getPrice() - config.collar)
+					return REJECT_COLLAR;
+			}
+			TraderId trader = order->trader;
+			if(trader >= limits.size())
+				return 0;
+			const RiskLimits& l = limits[trader];
+			int64_t qty = order->quantity;
+			if(l.maxOrderQty > 0 && qty > l.maxOrderQty)
+				return REJECT_ORDER_QTY;
+			OpenQuantity o = getOpenQuantity(trader);
+			if(l.maxOpenQty > 0 && o.buy + o.sell + qty > l.maxOpenQty)
+				return REJECT_OPEN_QTY;
+			if(l.maxPosition > 0) {
+				int64_t position = trader < account.size() ? account[trader] : 0;
+				int64_t worst = isBuy ? position + o.buy + qty : o.sell + qty - position;
+				if(worst > l.maxPosition)
+					return REJECT_POSITION;
+			}
+			if(l.maxNotional > 0) {
+				const PriceNode* contra = isBuy ? bestAsk : bestBid;
+				int64_t price = !market ? order->price : contra != NULL ? contra->getPrice() : 0;
+				if(price * qty > l.maxNotional)
+					return REJECT_NOTIONAL;
+			}
+			return 0;
+		}
+
+		inline void OrderBook::setRiskLimits(TraderId trader, const RiskLimits& traderLimits) {
+			bookTradeForTrader(trader);
+			if(trader >= limits.size()) {
+				RiskLimits none = { 0, 0, 0, 0 };
+				limits.resize(trader + 1, none);
+			}
+			limits[trader] = traderLimits;
+		}
+
+		inline void OrderBook::bookTrade(int qty, TraderId buyer, TraderId seller) {
+			if(buyer < account.size() && booked[buyer])
+				account[buyer] += qty;
+			if(seller < account.size() && booked[seller])
+				account[seller] -= qty;
 		}
 
 		inline void OrderBook::bookTradeForTrader(const vector<string>& names) {
 			//initialise a trading account for the trader
-			for(string name : names) {
-				account->emplace(name,0);
+			for(const string& name : names)
+				bookTradeForTrader(traderTable().intern(name));
+		}
+
+		inline void OrderBook::setExposure(TraderId trader, int exposure) {
+			bookTradeForTrader(trader);
+			account[trader] = exposure;
+		}
+
+		inline void OrderBook::bookTradeForTrader(TraderId trader) {
+			if(trader >= account.size()) {
+				account.resize(trader + 1, 0);
+				booked.resize(trader + 1, 0);
 			}
+			booked[trader] = 1;
 		}
 
-		inline int OrderBook::getTraderExposure(const string& name) {
-			AccountMapIt it = account->find(name);
-			if(it != account->end())
-				return it->second;
+		inline int OrderBook::getTraderExposure(const string& name) const {
+			TraderId trader = traderTable().find(name);
+			if(trader < account.size())
+				return account[trader];
 			else return 0;
 		}
 
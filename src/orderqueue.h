@@ -0,0 +1,186 @@
+/* OrderQueue - the resting orders of one price level */
+/* Each resting order sits in an OrderSlot, and the slots of a level form a doubly
+linked list owned by its PriceNode. Filling the head, appending at the tail and
+unlinking any slot are all O(1); a partial fill updates the head in place instead
+of removing and re-inserting it. A SIZE_TIME level also keeps its slots in an
+ordered index, so finding the place of a new or partially filled order is
+O(log n) in the level depth instead of a walk of the list. The index and its
+nodes come from the book's NodeArena like the ladder's. */
+
+#ifndef ORDERQUEUE_H
+#define ORDERQUEUE_H
+
+#include <cstddef>
+#include <set>
+#include "order.h"
+#include "pool.h"
+using namespace std;
+
+namespace Matching {
+	class PriceNode;
+
+	/* queue priority inside a price level.
+	PRICE_TIME : strict FIFO, the earliest order at the level trades first
+	SIZE_TIME  : bigger orders first, earliest first among equal sizes
+	PRO_RATA   : an incoming order smaller than the level is shared out in
+	proportion to the resting quantities, the queue is kept in time order
+	for the lots the rounding leaves
+	PRO_RATA_TOP : hybrid, the front order of the queue is filled first and
+	the rest is shared out like PRO_RATA */
+	enum PriorityPolicy {
+		PRICE_TIME,
+		SIZE_TIME,
+		PRO_RATA,
+		PRO_RATA_TOP
+	};
+
+	/*one resting order, linked into the queue of its level. an iceberg
+	shows order->quantity (at most peak) and keeps reserve hidden, the next
+	slice comes out of the reserve when the shown one is filled */
+	struct OrderSlot {
+		Order* order;
+		OrderSlot* prev;
+		OrderSlot* next;
+		PriceNode* level;
+		int peak; //0 unless iceberg
+		int reserve;
+		//SIZE_TIME only : the quantity the slot is indexed at, see OrderQueue
+		int rank;
+
+		OrderSlot(Order* order_, PriceNode* level_) :
+		order(order_), prev(NULL), next(NULL), level(level_), peak(0), reserve(0), rank(0) {}
+	};
+
+	/* Comparator - if size is bigger, return true
+	in case of equal sizes, lesser timestamp one wins. the size is the rank
+	of the slot, so a slot whose order just traded is still found under
+	the key it was indexed with */
+	struct SlotSizeTimeComparator {
+		bool operator()(const OrderSlot* a, const OrderSlot* b) const {
+			if(a->rank != b->rank) return a->rank > b->rank;
+			else return a->order->time < b->order->time;
+		}
+	};
+	//equal keys keep their arrival order, a multiset inserts at the upper bound
+	typedef multiset<OrderSlot*, SlotSizeTimeComparator, PoolAllocator<OrderSlot*> > SizeTimeIndex;
+
+	class OrderQueue {
+	private:
+		OrderSlot* head;
+		OrderSlot* tail;
+		int count;
+		/*SIZE_TIME levels only, NULL until the first insert. holds every slot
+		of the list in the same order, the list stays what is walked.
+		allocated from arena, which a SIZE_TIME queue must be given */
+		NodeArena* arena;
+		SizeTimeIndex* sizes;
+
+		OrderQueue(const OrderQueue&);
+		OrderQueue& operator=(const OrderQueue&);
+
+	public:
+		OrderQueue(NodeArena* arena_ = NULL) : head(NULL), tail(NULL), count(0), arena(arena_), sizes(NULL) {}
+		~OrderQueue() {
+			if(sizes != NULL) {
+				sizes->~SizeTimeIndex();
+				arena->free(sizes, sizeof(SizeTimeIndex));
+			}
+		}
+
+		bool empty() const { return head == NULL; }
+		int size() const { return count; }
+		OrderSlot* front() const { return head; }
+		OrderSlot* back() const { return tail; }
+
+		void pushBack(OrderSlot* slot);
+		void insertBefore(OrderSlot* pos, OrderSlot* slot);
+		void unlink(OrderSlot* slot);
+
+		//places the slot according to the level priority
+		void insert(OrderSlot* slot, PriorityPolicy policy);
+		//moves a slot whose quantity just went down to its place under SIZE_TIME
+		void reposition(OrderSlot* slot, PriorityPolicy policy);
+	};
+
+	inline void OrderQueue::pushBack(OrderSlot* slot) {
+		slot->prev = tail;
+		slot->next = NULL;
+		if(tail != NULL)
+			tail->next = slot;
+		else
+			head = slot;
+		tail = slot;
+		++count;
+	}
+
+	inline void OrderQueue::insertBefore(OrderSlot* pos, OrderSlot* slot) {
+		if(pos == NULL) {
+			pushBack(slot);
+			return;
+		}
+		slot->next = pos;
+		slot->prev = pos->prev;
+		if(pos->prev != NULL)
+			pos->prev->next = slot;
+		else
+			head = slot;
+		pos->prev = slot;
+		++count;
+	}
+
+	inline void OrderQueue::unlink(OrderSlot* slot) {
+		if(sizes != NULL) {
+			//a few slots at most share a size and a time
+			pair<SizeTimeIndex::iterator, SizeTimeIndex::iterator> range = sizes->equal_range(slot);
+			for(SizeTimeIndex::iterator it = range.first; it != range.second; ++it) {
+				if(*it == slot) {
+					sizes->erase(it);
+					break;
+				}
+			}
+		}
+		if(slot->prev != NULL)
+			slot->prev->next = slot->next;
+		else
+			head = slot->next;
+		if(slot->next != NULL)
+			slot->next->prev = slot->prev;
+		else
+			tail = slot->prev;
+		slot->prev = slot->next = NULL;
+		--count;
+	}
+
+	inline void OrderQueue::insert(OrderSlot* slot, PriorityPolicy policy) {
+		if(policy != SIZE_TIME) {
+			pushBack(slot);
+			return;
+		}
+		if(sizes == NULL)
+			sizes = new (arena->alloc(sizeof(SizeTimeIndex))) SizeTimeIndex(
+				SlotSizeTimeComparator(), PoolAllocator<OrderSlot*>(arena));
+		slot->rank = slot->order->quantity;
+		//the slot goes in the list right before its successor in the index
+		SizeTimeIndex::iterator it = sizes->insert(slot);
+		++it;
+		insertBefore(it != sizes->end() ? *it : NULL, slot);
+	}
+
+	inline void OrderQueue::reposition(OrderSlot* slot, PriorityPolicy policy) {
+		if(policy != SIZE_TIME || slot->rank == slot->order->quantity)
+			return;
+		/*the quantity only went down, so the slot is still behind its
+		predecessor. when it also stays ahead of its successor, the rank is
+		changed in place and the index keeps its order : O(1) */
+		int rank = slot->rank;
+		slot->rank = slot->order->quantity;
+		if(slot->next == NULL || !SlotSizeTimeComparator()(slot->next, slot))
+			return;
+		//O(log n)
+		slot->rank = rank;
+		unlink(slot);
+		insert(slot, policy);
+	}
+}
+
+#endif /*ORDERQUEUE_H*/
@@ -0,0 +1,207 @@
+/* Pools - slab allocation with free-list recycling for the book */
+/* A BlockPool hands out fixed size blocks carved from large chunks. Freed
+blocks go on a free list and are handed out again first, so once the pool
+is reserved to its working size the book never goes to the global heap.
+ObjectPool builds typed objects on a BlockPool, NodeArena and PoolAllocator
+do the same for the nodes of the std containers the book uses. */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace Matching {
+	#define POOL_ALIGN 16
+	#define POOL_CHUNK 1024 //blocks per chunk when a pool grows on demand
+
+	class BlockPool {
+	private:
+		struct FreeBlock { FreeBlock* next; };
+		struct Chunk {
+			char* base;
+			size_t bytes;
+			bool operator<(const Chunk& other) const { return base < other.base; }
+		};
+
+		size_t blockSize;
+		FreeBlock* freeList;
+		//sorted by address, owns is a binary search
+		vector<Chunk> chunks;
+		size_t total; //blocks carved so far
+		size_t used;
+
+		void grow(size_t nBlocks);
+
+		//no copies, the free list points into our chunks
+		BlockPool(const BlockPool&);
+		BlockPool& operator=(const BlockPool&);
+
+	public:
+		BlockPool(size_t blockSize_, size_t capacity = 0) :
+		blockSize((max(blockSize_, sizeof(FreeBlock)) + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1)),
+		freeList(NULL), total(0), used(0) {
+			reserve(capacity);
+		}
+		~BlockPool() {
+			for(size_t i = 0; i < chunks.size(); ++i)
+				::operator delete(chunks[i].base);
+		}
+
+		//makes sure n blocks can be in use without growing again
+		void reserve(size_t n) {
+			if(n > total)
+				grow(n - total);
+		}
+
+		void* alloc() {
+			if(freeList == NULL)
+				grow(total > POOL_CHUNK ? total : POOL_CHUNK);
+			FreeBlock* block = freeList;
+			freeList = block->next;
+			++used;
+			return block;
+		}
+
+		void free(void* p) {
+			FreeBlock* block = static_cast<FreeBlock*>(p);
+			block->next = freeList;
+			freeList = block;
+			--used;
+		}
+
+		//true if p was carved from this pool. O(log chunks)
+		bool owns(const void* p) const {
+			Chunk key;
+			key.base = const_cast<char*>(static_cast<const char*>(p));
+			//the last chunk starting at or below p is the only candidate
+			vector<Chunk>::const_iterator it = upper_bound(chunks.begin(), chunks.end(), key);
+			if(it == chunks.begin())
+				return false;
+			--it;
+			return key.base < it->base + it->bytes;
+		}
+
+		size_t getBlockSize() const { return blockSize; }
+		size_t capacity() const { return total; }
+		size_t inUse() const { return used; }
+	};
+
+	inline void BlockPool::grow(size_t nBlocks) {
+		Chunk chunk;
+		chunk.bytes = nBlocks * blockSize;
+		chunk.base = static_cast<char*>(::operator new(chunk.bytes));
+		chunks.insert(upper_bound(chunks.begin(), chunks.end(), chunk), chunk);
+		//thread the new blocks on the free list in address order
+		for(size_t i = nBlocks; i > 0; --i) {
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk.base + (i - 1) * blockSize);
+			block->next = freeList;
+			freeList = block;
+		}
+		total += nBlocks;
+	}
+
+	/*typed pool, create/destroy replace new/delete */
+	template<typename T>
+	class ObjectPool {
+	private:
+		BlockPool blocks;
+	public:
+		ObjectPool(size_t capacity = 0) : blocks(sizeof(T), capacity) {}
+
+		void reserve(size_t n) { blocks.reserve(n); }
+
+		template<typename... Args>
+		T* create(Args&&... args) {
+			return new (blocks.alloc()) T(std::forward<Args>(args)...);
+		}
+
+		void destroy(T* p) {
+			p->~T();
+			blocks.free(p);
+		}
+
+		bool owns(const T* p) const { return blocks.owns(p); }
+		size_t capacity() const { return blocks.capacity(); }
+		size_t inUse() const { return blocks.inUse(); }
+	};
+
+	/*size classes of POOL_ALIGN bytes for container nodes. anything bigger
+	than ARENA_MAX_BLOCK (hash bucket arrays) goes to the heap, containers
+	reserve those up front */
+	#define ARENA_MAX_BLOCK 256
+
+	class NodeArena {
+	private:
+		BlockPool* classes[ARENA_MAX_BLOCK / POOL_ALIGN];
+
+		NodeArena(const NodeArena&);
+		NodeArena& operator=(const NodeArena&);
+
+		static size_t classOf(size_t bytes) { return (bytes - 1) / POOL_ALIGN; }
+
+	public:
+		NodeArena() {
+			for(size_t i = 0; i < ARENA_MAX_BLOCK / POOL_ALIGN; ++i)
+				classes[i] = NULL;
+		}
+		~NodeArena() {
+			for(size_t i = 0; i < ARENA_MAX_BLOCK / POOL_ALIGN; ++i)
+				delete classes[i];
+		}
+
+		BlockPool& pool(size_t bytes) {
+			BlockPool*& p = classes[classOf(bytes)];
+			if(p == NULL)
+				p = new BlockPool((classOf(bytes) + 1) * POOL_ALIGN);
+			return *p;
+		}
+
+		void* alloc(size_t bytes) {
+			if(bytes > ARENA_MAX_BLOCK)
+				return ::operator new(bytes);
+			return pool(bytes).alloc();
+		}
+
+		void free(void* p, size_t bytes) {
+			if(bytes > ARENA_MAX_BLOCK)
+				::operator delete(p);
+			else
+				pool(bytes).free(p);
+		}
+	};
+
+	/*std allocator over a NodeArena, copies share the arena */
+	template<typename T>
+	struct PoolAllocator {
+		typedef T value_type;
+		NodeArena* arena;
+
+		PoolAllocator(NodeArena* arena_) : arena(arena_) {}
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(size_t n) { return static_cast<T*>(arena->alloc(n * sizeof(T))); }
+		void deallocate(T* p, size_t n) { arena->free(p, n * sizeof(T)); }
+	};
+
+	/*runs n nodes through an empty node based map and clears it again, the
+	nodes stay on the free list of the map's arena for the hot path */
+	template<typename Map>
+	inline void prefaultNodes(Map& m, size_t n) {
+		for(size_t i = 0; i < n; ++i)
+			m.emplace(typename Map::key_type(i), typename Map::mapped_type());
+		m.clear();
+	}
+
+	template<typename T, typename U>
+	inline bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.arena == b.arena; }
+	template<typename T, typename U>
+	inline bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.arena != b.arena; }
+}
+
+#endif /*POOL_H*/
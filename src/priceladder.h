@@ -0,0 +1,217 @@
+/* PriceLadder - one side (bid or ask) of the order book */
+/* A ladder maps a price to its PriceNode and knows the best level of its side.
+TreeLadder is the map + hashmap pair the book always used, it takes any price.
+ArrayLadder is a contiguous tick-indexed array for instruments with a bounded
+price range: a price is an index from basePrice, a bitmap of non empty levels
+gives the next level by a word scan and the best level is a cached cursor. */
+
+#ifndef PRICELADDER_H
+#define PRICELADDER_H
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "pool.h"
+using namespace std;
+
+namespace Matching {
+	class PriceNode;
+
+	typedef PriceNode* PriceNodePtr;
+	//tree and hashmap nodes come from the book's NodeArena
+	typedef PoolAllocator<pair<const int, PriceNodePtr> > LevelAllocator;
+	typedef map<int, PriceNodePtr, less<int>, LevelAllocator> PriceTree;
+	//PriceTree will comprise of the price, and the respective pointer
+	//or order corresponding to that price
+	typedef PriceTree::iterator PriceTreeIt;
+	typedef PriceTree::const_iterator PriceTreeConstIt;
+	typedef PriceTree::reverse_iterator PriceTreeRevIt;
+	typedef unordered_map<int, PriceNodePtr, hash<int>, equal_to<int>, LevelAllocator> PriceToNodeMap;
+	//a price to Order hash table like structure for all orders
+	typedef PriceToNodeMap::iterator PriceToNodeMapIt;
+	typedef PriceToNodeMap::const_iterator PriceToNodeMapConstIt;
+
+	enum LadderType {
+		TREE_LADDER,
+		ARRAY_LADDER
+	};
+
+	/*levels are walked from the best price away from the touch:
+	descending for bids, ascending for asks. both ladders are final, the
+	book calls them through their own type on the hot paths, see
+	OrderBook::sweep */
+	class PriceLadder {
+	protected:
+		bool isBid;
+	public:
+		PriceLadder(bool isBid_) : isBid(isBid_) {}
+		virtual ~PriceLadder() {}
+
+		bool bidSide() const { return isBid; }
+		//true if a level at this price can be held by the ladder
+		virtual bool accepts(int price) const = 0;
+		virtual PriceNode* find(int price) const = 0;
+		virtual void insert(int price, PriceNode* level) = 0;
+		virtual void erase(int price) = 0;
+		//best level, NULL when the side is empty
+		virtual PriceNode* best() const = 0;
+		//next level after price, away from the touch. NULL at the end
+		virtual PriceNode* next(int price) const = 0;
+		virtual bool empty() const = 0;
+		virtual int size() const = 0;
+	};
+
+	/*binary sorted tree (map) with a hashmap on the side
+	to make find() O(1) when the price already exists.
+	capacity levels worth of nodes are allocated up front */
+	class TreeLadder final : public PriceLadder {
+	private:
+		PriceTree tree;
+		PriceToNodeMap nodes;
+	public:
+		TreeLadder(bool isBid_, NodeArena* arena, size_t capacity = 0) :
+		PriceLadder(isBid_), tree(less<int>(), LevelAllocator(arena)),
+		nodes(0, hash<int>(), equal_to<int>(), LevelAllocator(arena)) {
+			if(capacity > 0) {
+				nodes.reserve(capacity);
+				prefaultNodes(tree, capacity);
+				prefaultNodes(nodes, capacity);
+			}
+		}
+
+		bool accepts(int price) const { return true; }
+		PriceNode* find(int price) const {
+			PriceToNodeMapConstIt it = nodes.find(price);
+			return it != nodes.end() ? it->second : NULL;
+		}
+		void insert(int price, PriceNode* level) {
+			tree.emplace(price, level);
+			nodes.emplace(price, level);
+		}
+		void erase(int price) {
+			tree.erase(price);
+			nodes.erase(price);
+		}
+		PriceNode* best() const {
+			if(tree.empty())
+				return NULL;
+			return isBid ? tree.rbegin()->second : tree.begin()->second;
+		}
+		PriceNode* next(int price) const {
+			if(isBid) {
+				PriceTreeConstIt it = tree.lower_bound(price);
+				return it != tree.begin() ? (--it)->second : NULL;
+			}
+			PriceTreeConstIt it = tree.upper_bound(price);
+			return it != tree.end() ? it->second : NULL;
+		}
+		bool empty() const { return tree.empty(); }
+		int size() const { return tree.size(); }
+
+		const PriceTree& getTree() const { return tree; }
+	};
+
+	/*tick indexed ladder, level i holds price basePrice + i.
+	the arrays are only allocated when the first level comes in */
+	class ArrayLadder final : public PriceLadder {
+	private:
+		int basePrice;
+		int numTicks;
+		vector<PriceNode*> levels;
+		vector<uint64_t> nonEmpty; //bit i set when levels[i] holds a level
+		int bestIdx; //-1 when empty
+		int count;
+
+		int nextSet(int from) const; //first set bit >= from, -1 if none
+		int prevSet(int from) const; //last set bit <= from, -1 if none
+
+	public:
+		ArrayLadder(bool isBid_, int basePrice_, int numTicks_) :
+		PriceLadder(isBid_), basePrice(basePrice_), numTicks(numTicks_),
+		bestIdx(-1), count(0) {}
+
+		bool accepts(int price) const {
+			return price >= basePrice && price - basePrice < numTicks;
+		}
+		PriceNode* find(int price) const {
+			return accepts(price) && !levels.empty() ? levels[price - basePrice] : NULL;
+		}
+		void insert(int price, PriceNode* level);
+		void erase(int price);
+		PriceNode* best() const { return bestIdx >= 0 ? levels[bestIdx] : NULL; }
+		PriceNode* next(int price) const;
+		bool empty() const { return count == 0; }
+		int size() const { return count; }
+
+		int getBasePrice() const { return basePrice; }
+		int getNumTicks() const { return numTicks; }
+	};
+
+	inline int ArrayLadder::nextSet(int from) const {
+		if(from < 0)
+			from = 0;
+		if(from >= numTicks)
+			return -1;
+		int word = from >> 6;
+		uint64_t bits = nonEmpty[word] & (~0ULL << (from & 63));
+		while(bits == 0) {
+			if(++word >= (int)nonEmpty.size())
+				return -1;
+			bits = nonEmpty[word];
+		}
+		return (word << 6) + __builtin_ctzll(bits);
+	}
+
+	inline int ArrayLadder::prevSet(int from) const {
+		if(from >= numTicks)
+			from = numTicks - 1;
+		if(from < 0)
+			return -1;
+		int word = from >> 6;
+		uint64_t bits = nonEmpty[word] & (~0ULL >> (63 - (from & 63)));
+		while(bits == 0) {
+			if(--word < 0)
+				return -1;
+			bits = nonEmpty[word];
+		}
+		return (word << 6) + 63 - __builtin_clzll(bits);
+	}
+
+	inline void ArrayLadder::insert(int price, PriceNode* level) {
+		if(levels.empty()) {
+			levels.assign(numTicks, (PriceNode*)NULL);
+			nonEmpty.assign((numTicks + 63) / 64, 0);
+		}
+		int idx = price - basePrice;
+		levels[idx] = level;
+		nonEmpty[idx >> 6] |= 1ULL << (idx & 63);
+		++count;
+		if(bestIdx < 0 || (isBid ? idx > bestIdx : idx < bestIdx))
+			bestIdx = idx;
+	}
+
+	inline void ArrayLadder::erase(int price) {
+		if(!accepts(price) || count == 0)
+			return;
+		int idx = price - basePrice;
+		if(levels[idx] == NULL)
+			return;
+		levels[idx] = NULL;
+		nonEmpty[idx >> 6] &= ~(1ULL << (idx & 63));
+		--count;
+		if(idx == bestIdx)
+			bestIdx = isBid ? prevSet(idx - 1) : nextSet(idx + 1);
+	}
+
+	inline PriceNode* ArrayLadder::next(int price) const {
+		if(count == 0)
+			return NULL;
+		int idx = price - basePrice;
+		int found = isBid ? prevSet(idx - 1) : nextSet(idx + 1);
+		return found >= 0 ? levels[found] : NULL;
+	}
+}
+
+#endif /*PRICELADDER_H*/
@@ -0,0 +1,250 @@
+/* Implementation of the sharded matching engine */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include "shardedEngine.h"
+#include "csvReader.h"
+
+namespace Matching {
+	//results are only counted by run and replay, poll drains the rings
+	struct CountSink {
+		size_t n;
+		CountSink() : n(0) {}
+		void operator()(const ShardResult&) { ++n; }
+	};
+
+	ShardedEngine::ShardedEngine(size_t nShards, const BookConfig& config, size_t ringSize) :
+	running(false) {
+		if(nShards == 0)
+			nShards = 1;
+		for(size_t i = 0; i < nShards; ++i)
+			shards.push_back(new Shard(config, ringSize));
+		pending.reserve(ringSize * nShards);
+	}
+
+	ShardedEngine::~ShardedEngine() {
+		stop();
+		for(size_t i = 0; i < shards.size(); ++i)
+			delete shards[i];
+	}
+
+	void ShardedEngine::init(const vector<string>& names) {
+		for(size_t i = 0; i < shards.size(); ++i)
+			shards[i]->engine.init(names);
+	}
+
+	bool ShardedEngine::addInstrument(const string& symbol, const BookConfig& config) {
+		if(running)
+			return false;
+		return shards[shardOf(symbolTable().intern(symbol))]->engine.addInstrument(symbol, config);
+	}
+
+	void ShardedEngine::setEventForwarding(bool forward) {
+		if(running)
+			return;
+		for(size_t i = 0; i < shards.size(); ++i)
+			shards[i]->engine.setEventBuffer(forward ? &shards[i]->events : NULL);
+	}
+
+	void ShardedEngine::start(bool pin) {
+		if(running)
+			return;
+		running = true;
+		unsigned nCpus = thread::hardware_concurrency();
+		for(size_t i = 0; i < shards.size(); ++i) {
+			Shard* shard = shards[i];
+			shard->done = false;
+			shard->worker = thread(&ShardedEngine::work, this, shard);
+			if(pin && nCpus > 1) {
+				cpu_set_t cpus;
+				CPU_ZERO(&cpus);
+				CPU_SET((i + 1) % nCpus, &cpus);
+				pthread_setaffinity_np(shard->worker.native_handle(), sizeof(cpus), &cpus);
+			}
+		}
+	}
+
+	void ShardedEngine::stop() {
+		if(!running)
+			return;
+		running.store(false, memory_order_release);
+		//a worker blocked on a full output ring needs the merger to go on
+		for(size_t i = 0; i < shards.size(); ++i) {
+			SpinWait wait;
+			while(!shards[i]->done.load(memory_order_acquire)) {
+				collect();
+				wait();
+			}
+			shards[i]->worker.join();
+		}
+		collect();
+	}
+
+	void ShardedEngine::work(Shard* shard) {
+		ShardMessage message;
+		SpinWait idle;
+		while(true) {
+			if(!shard->input.pop(message)) {
+				//stop is stored after the last push, so empty here is final
+				if(!running.load(memory_order_acquire) && shard->input.empty())
+					break;
+				idle();
+				continue;
+			}
+			idle.reset();
+			ShardOutput output;
+			output.kind = SHARD_RESULT;
+			output.result = execute(shard->engine, message);
+			//empty unless events are forwarded
+			ShardOutput event;
+			event.kind = SHARD_EVENT;
+			for(const ExecEvent& e : shard->events) {
+				event.event = e;
+				push(shard, event);
+			}
+			shard->events.clear();
+			push(shard, output);
+		}
+		shard->done.store(true, memory_order_release);
+	}
+
+	void ShardedEngine::push(Shard* shard, const ShardOutput& output) {
+		SpinWait full;
+		while(!shard->output.push(output))
+			full();
+	}
+
+	ShardResult ShardedEngine::execute(MatchingEngine& engine, const ShardMessage& message) {
+		const Order& order = message.order;
+		ShardResult result = { message.seq, order.id, order.trader, order.symbol, message.type, 1, 0, 0 };
+		switch(message.type) {
+		case LOG_NEW:
+			result.remaining = engine.processOrder(engine.bookFor(order.symbol)->newOrder(order), message.arg);
+			result.filled = order.quantity - result.remaining;
+			break;
+		case LOG_STOP:
+			result.remaining = engine.processStop(engine.bookFor(order.symbol)->newOrder(order), message.arg);
+			result.filled = order.quantity - result.remaining;
+			break;
+		case LOG_CANCEL:
+			result.ok = engine.cancelOrder(order.id, order.symbol);
+			break;
+		case LOG_REPLACE:
+			result.ok = engine.replaceOrder(order.id, order.price, order.quantity, order.symbol);
+			break;
+		case LOG_AUCTION:
+			if(message.arg)
+				engine.beginAuction(order.symbol);
+			else
+				result.filled = engine.uncross(order.symbol);
+			break;
+		}
+		return result;
+	}
+
+	void ShardedEngine::collect() {
+		ShardOutput output;
+		for(size_t i = 0; i < shards.size(); ++i)
+			while(shards[i]->output.pop(output))
+				pending.push_back(output);
+	}
+
+	void ShardedEngine::submit(uint8_t type, const Order& order, int arg) {
+		SymbolId symbol = order.symbol;
+		if(symbol >= sequence.size())
+			sequence.resize(symbol + 1, 0);
+		ShardMessage message = { sequence[symbol]++, order, type, arg };
+		Shard* shard = shards[shardOf(symbol)];
+		SpinWait wait;
+		while(!shard->input.push(message)) {
+			collect();
+			wait();
+		}
+	}
+
+	int ShardedEngine::getTraderExposure(const string& name) const {
+		int exposure = 0;
+		for(size_t i = 0; i < shards.size(); ++i)
+			exposure += shards[i]->engine.getTraderExposure(name);
+		return exposure;
+	}
+
+#ifdef MATCHING_STATS
+	void ShardedEngine::dumpStats(FILE* out) const {
+		for(size_t i = 0; i < shards.size(); ++i) {
+			fprintf(out, "shard %zu\n", i);
+			shards[i]->engine.dumpStats(out);
+		}
+	}
+#endif
+
+	void ShardedEngine::report(size_t bytes, size_t nOrders, size_t badLines, double seconds) {
+		MatchingEngine::reportThroughput(bytes, nOrders, badLines, seconds);
+		int exposure = getTraderExposure(TRADER);
+		string str = exposure >= 0 ? "L" : "S";
+		cout << str << endl;
+		cout << abs(exposure) << endl;
+	}
+
+	int ShardedEngine::run(const string& inFile) {
+		CsvOrderReader reader;
+		if(!reader.open(inFile)) {
+			fprintf(stderr, "Cannot open file at %s\n", inFile.c_str());
+			return -1;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		this->start();
+		CountSink sink;
+		size_t nOrders = 0;
+		Order parsed;
+		while(reader.next(parsed)) {
+			submit(LOG_NEW, parsed);
+			if((++nOrders & (SHARD_RING_SIZE - 1)) == 0)
+				poll(sink);
+		}
+		stop();
+		poll(sink);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		report(reader.getBytes(), nOrders, reader.getBadLines(), seconds);
+		return 0;
+	}
+
+	int ShardedEngine::replay(const string& binFile) {
+		BinaryLogReader reader;
+		if(!reader.open(binFile)) {
+			fprintf(stderr, "Cannot open binary log at %s\n", binFile.c_str());
+			return -1;
+		}
+		vector<TraderId> traders;
+		for(const string& name : reader.getTraders())
+			traders.push_back(traderTable().intern(name));
+		vector<SymbolId> symbols;
+		for(const string& name : reader.getInstruments())
+			symbols.push_back(symbolTable().intern(name));
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		this->start();
+		CountSink sink;
+		size_t nOrders = 0;
+		for(const LogRecord* record = reader.begin(); record != reader.end(); ++record) {
+			if(!reader.check(*record))
+				continue;
+			//only a NEW has to name a trader of the table
+			Order order(record->id, record->type == LOG_NEW ? traders[record->trader] : 0, record->price,
+				record->quantity, record->time, false, symbols[record->instrument]);
+			order.flags = record->flags;
+			submit(record->type, order);
+			if((++nOrders & (SHARD_RING_SIZE - 1)) == 0)
+				poll(sink);
+		}
+		stop();
+		poll(sink);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		report(reader.getBytes(), reader.size() - reader.getBadRecords(), reader.getBadRecords(), seconds);
+		return 0;
+	}
+}
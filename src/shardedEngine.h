@@ -0,0 +1,175 @@
+/* Sharded Matching Engine - one pinned worker thread per partition of instruments */
+/* Instrument s belongs to shard s % nShards. Each shard owns a MatchingEngine
+(and so its books) that only its worker thread ever touches, so book state
+needs no lock. The caller thread is the dispatcher: it parses the input and
+pushes messages into the shard's input ring. Workers push one result per
+message into their output ring, and poll() merges the output rings. With
+event forwarding on, the execution events of a message (trades, and with
+them the exposure changes of both traders) go through the same ring right
+before its result.
+
+An instrument lives in exactly one shard and both rings are FIFO, so the
+merged stream keeps the order of every instrument, results of different
+instruments interleave freely.
+
+Names are interned by the dispatcher only. Traders and instruments must be
+set up with init and addInstrument before start, workers never touch
+traderTable() or symbolTable(). */
+
+#ifndef SHARDED_ENGINE_H
+#define SHARDED_ENGINE_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "matchingEngine.h"
+#include "spscQueue.h"
+
+namespace Matching {
+	#define SHARD_RING_SIZE 4096
+
+	/*dispatcher to worker. type is a LogRecordType, CANCEL only uses
+	order.id and order.symbol, REPLACE also price and quantity. a STOP
+	is a new stop order, an AUCTION only uses order.symbol */
+	struct ShardMessage {
+		uint64_t seq; //per instrument
+		Order order;
+		uint8_t type;
+		int arg; //NEW : iceberg peak, STOP : trigger price, AUCTION : 1 call phase, 0 uncross
+	};
+
+	//worker to merger, one per message
+	struct ShardResult {
+		uint64_t seq;
+		OrderId id;
+		TraderId trader;
+		SymbolId symbol;
+		uint8_t type;
+		uint8_t ok; //cancel or replace found the order
+		int filled; //NEW : quantity the aggressor traded, AUCTION : volume of the uncross
+		int remaining; //NEW only, quantity that rested or was dropped
+	};
+
+	enum ShardOutputKind {
+		SHARD_RESULT,
+		SHARD_EVENT
+	};
+
+	//what goes through an output ring, a message's events and then its result
+	struct ShardOutput {
+		uint8_t kind; //ShardOutputKind
+		union {
+			ShardResult result;
+			ExecEvent event;
+		};
+	};
+
+	//poll without an event sink drops the events
+	struct IgnoreEvents {
+		void operator()(const ExecEvent&) {}
+	};
+
+	class ShardedEngine {
+	private:
+		struct Shard {
+			MatchingEngine engine;
+			//the engine's event buffer when events are forwarded
+			EventBuffer events;
+			SpscQueue<ShardMessage> input;
+			SpscQueue<ShardOutput> output;
+			atomic<bool> done;
+			thread worker;
+
+			Shard(const BookConfig& config, size_t ringSize) :
+			engine(config), input(ringSize), output(ringSize), done(false) {}
+		};
+
+		vector<Shard*> shards;
+		//next sequence number of every instrument
+		vector<uint64_t> sequence;
+		//results and events taken off the rings while the dispatcher waited
+		vector<ShardOutput> pending;
+		atomic<bool> running;
+
+		ShardedEngine(const ShardedEngine&);
+		ShardedEngine& operator=(const ShardedEngine&);
+
+		void work(Shard* shard);
+		static ShardResult execute(MatchingEngine& engine, const ShardMessage& message);
+		//worker, spins while the output ring is full
+		static void push(Shard* shard, const ShardOutput& output);
+		template<typename Sink, typename EventSink>
+		static void deliver(const ShardOutput& output, Sink& sink, EventSink& eventSink, size_t& n) {
+			if(output.kind == SHARD_EVENT)
+				eventSink(output.event);
+			else {
+				sink(output.result);
+				++n;
+			}
+		}
+		//moves every available result to pending
+		void collect();
+		void report(size_t bytes, size_t nOrders, size_t badLines, double seconds);
+
+	public:
+		ShardedEngine(size_t nShards, const BookConfig& config = BookConfig(), size_t ringSize = SHARD_RING_SIZE);
+		virtual ~ShardedEngine();
+
+		size_t getShardCount() const { return shards.size(); }
+		size_t shardOf(SymbolId symbol) const { return symbol % shards.size(); }
+
+		//setup, before start
+		void init(const vector<string>& names);
+		bool addInstrument(const string& symbol, const BookConfig& config);
+		//every event of the books (see events.h) goes to the merger, off by default
+		void setEventForwarding(bool forward);
+
+		/*starts the workers. with pin, worker i runs on cpu i + 1 so the
+		dispatcher keeps cpu 0. pinning is best effort */
+		void start(bool pin = true);
+		//waits for every submitted message, then joins the workers
+		void stop();
+
+		//dispatcher side, spins while the shard's ring is full
+		void submit(uint8_t type, const Order& order, int arg = 0);
+		/*merger, hands every result available so far to sink(const ShardResult&)
+		and the events that came before them to eventSink(const ExecEvent&).
+		per instrument both come in the order of a single engine. returns the
+		number of results */
+		template<typename Sink, typename EventSink>
+		size_t poll(Sink& sink, EventSink& eventSink);
+		template<typename Sink>
+		size_t poll(Sink& sink) {
+			IgnoreEvents none;
+			return poll(sink, none);
+		}
+
+		//the reads below are for a stopped engine
+		const OrderBook* getOrderBook(SymbolId symbol = DEFAULT_SYMBOL_ID) const {
+			return shards[shardOf(symbol)]->engine.getOrderBook(symbol);
+		}
+		int getTraderExposure(const string& name) const;
+	#ifdef MATCHING_STATS
+		void dumpStats(FILE* out) const;
+	#endif
+
+		int run(const string& inFile);
+		int replay(const string& binFile);
+	};
+
+	template<typename Sink, typename EventSink>
+	inline size_t ShardedEngine::poll(Sink& sink, EventSink& eventSink) {
+		//pending holds the older results of every shard
+		size_t n = 0;
+		for(size_t i = 0; i < pending.size(); ++i)
+			deliver(pending[i], sink, eventSink, n);
+		pending.clear();
+		ShardOutput output;
+		for(size_t i = 0; i < shards.size(); ++i)
+			while(shards[i]->output.pop(output))
+				deliver(output, sink, eventSink, n);
+		return n;
+	}
+}
+
+#endif /*SHARDED_ENGINE_H*/
@@ -0,0 +1,87 @@
+/* Book snapshot - the full state of every book of an engine */
+/* Layout, little-endian throughout:
+	SnapshotHeader                  32 bytes
+	trader table                    traderCount x LOG_NAME_LEN bytes
+	then for every book
+	SnapshotBook                    64 bytes
+	exposures                       accountCount x 8 bytes (SnapshotExposure)
+	resting orders                  orderCount x 32 bytes (Order)
+	icebergs                        icebergCount x 16 bytes (SnapshotIceberg)
+	stops                           stopCount x 40 bytes (SnapshotStop)
+The trader table only holds the traders the books refer to. Exposures
+cover the traders each book books trades for (see bookTradeForTrader),
+orders are the raw Order records, both with the trader replaced by its
+index in the trader table. Orders come bids then asks, every level in
+priority order and every queue front to back. Adding them back in file order rebuilds each queue as
+it was, so a restore is one pass over the mapped file after one bulk
+reservation of the pools. The quantity of an iceberg order is its shown
+slice, its peak and hidden reserve follow the orders. Stops come buys then
+sells, each side in firing order, with their owner mapped like the orders.
+A book in the call phase of an auction is restored in it, crossed.
+
+sequence is the number of input messages the engine had processed, a
+restored engine only replays the log records after it. */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include "binaryLog.h"
+
+namespace Matching {
+	#define SNAPSHOT_MAGIC "MATCHSNP"
+	#define SNAPSHOT_VERSION 3
+
+	struct SnapshotHeader {
+		char magic[8];
+		uint16_t version;
+		uint16_t reserved;
+		uint32_t bookCount;
+		uint32_t traderCount;
+		uint32_t reserved2;
+		uint64_t sequence;
+	};
+
+	struct SnapshotBook {
+		char symbol[LOG_SYMBOL_LEN];
+		uint8_t priority; //PriorityPolicy
+		uint8_t ladder; //LadderType
+		uint16_t minAllocation; //pro-rata books
+		int32_t basePrice;
+		int32_t numTicks;
+		uint32_t accountCount;
+		uint64_t orderCount;
+		uint32_t levelCount;
+		uint32_t icebergCount;
+		uint32_t stopCount;
+		int32_t lastTradePrice;
+		uint8_t auction; //1 in the call phase of an auction
+		uint8_t stp; //StpMode
+		uint8_t reserved[2];
+		int32_t collar;
+	};
+
+	struct SnapshotExposure {
+		uint32_t trader;
+		int32_t exposure;
+	};
+
+	struct SnapshotIceberg {
+		int64_t id;
+		int32_t peak;
+		int32_t reserve;
+	};
+
+	struct SnapshotStop {
+		Order order;
+		int32_t trigger;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(SnapshotHeader) == 32, "SnapshotHeader is 32 bytes on disk");
+	static_assert(sizeof(SnapshotBook) == 64, "SnapshotBook is 64 bytes on disk");
+	static_assert(sizeof(SnapshotStop) == 40, "SnapshotStop is 40 bytes on disk");
+	static_assert(sizeof(SnapshotIceberg) == 16, "SnapshotIceberg is 16 bytes on disk");
+}
+
+#endif /*SNAPSHOT_H*/
@@ -0,0 +1,104 @@
+/* SpscQueue - bounded lock-free ring between one producer and one consumer */
+/* The producer only writes tail and the consumer only writes head, each on
+its own cache line. Both sides keep a cached copy of the other index and
+only reload the shared one when the cache says the ring is full (or empty),
+so in steady state a push or pop touches no line the other thread writes. */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+namespace Matching {
+	#define CACHE_LINE 64
+
+	#define SPIN_LIMIT 64
+
+	/*backoff of a spin wait on a ring. pauses a few times, then gives the
+	core away so a waiter never starves the thread it waits for when both
+	share a core */
+	struct SpinWait {
+		unsigned spins;
+		SpinWait() : spins(0) {}
+		void operator()() {
+			if(spins < SPIN_LIMIT) {
+				++spins;
+	#if defined(__x86_64__) || defined(__i386__)
+				_mm_pause();
+	#endif
+			}
+			else
+				this_thread::yield();
+		}
+		void reset() { spins = 0; }
+	};
+
+	template<typename T>
+	class SpscQueue {
+	private:
+		//consumer side
+		alignas(CACHE_LINE) atomic<size_t> head;
+		size_t cachedTail;
+		//producer side
+		alignas(CACHE_LINE) atomic<size_t> tail;
+		size_t cachedHead;
+		//shared, read only
+		alignas(CACHE_LINE) T* items;
+		size_t mask;
+
+		SpscQueue(const SpscQueue&);
+		SpscQueue& operator=(const SpscQueue&);
+
+		static size_t roundUp(size_t n) {
+			size_t p = 2;
+			while(p < n)
+				p <<= 1;
+			return p;
+		}
+
+	public:
+		//capacity is rounded up to a power of two
+		SpscQueue(size_t capacity) :
+		head(0), cachedTail(0), tail(0), cachedHead(0),
+		items(new T[roundUp(capacity)]), mask(roundUp(capacity) - 1) {}
+		~SpscQueue() { delete[] items; }
+
+		//producer only. false if the ring is full
+		bool push(const T& item) {
+			size_t t = tail.load(memory_order_relaxed);
+			if(t - cachedHead > mask) {
+				cachedHead = head.load(memory_order_acquire);
+				if(t - cachedHead > mask)
+					return false;
+			}
+			items[t & mask] = item;
+			tail.store(t + 1, memory_order_release);
+			return true;
+		}
+
+		//consumer only. false if the ring is empty
+		bool pop(T& item) {
+			size_t h = head.load(memory_order_relaxed);
+			if(h == cachedTail) {
+				cachedTail = tail.load(memory_order_acquire);
+				if(h == cachedTail)
+					return false;
+			}
+			item = items[h & mask];
+			head.store(h + 1, memory_order_release);
+			return true;
+		}
+
+		//exact only from the consumer side
+		bool empty() const { return head.load(memory_order_acquire) == tail.load(memory_order_acquire); }
+		size_t capacity() const { return mask + 1; }
+	};
+}
+
+#endif /*SPSCQUEUE_H*/
@@ -0,0 +1,79 @@
+/*UNIT TESTS FOR THE BENCHMARK TOOLS */
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include "../src/histogram.h"
+#include "../src/orderFlow.h"
+using namespace std;
+using namespace Matching;
+
+/* Tests covered :
+1. Histogram percentiles within a bucket of the exact value
+2. Seeded order flow is reproducible and follows its ratios
+*/
+
+BOOST_AUTO_TEST_SUITE( Flow )
+
+BOOST_AUTO_TEST_CASE(TestHistogramPercentiles) {
+	LatencyHistogram h;
+	BOOST_CHECK_EQUAL(h.percentile(50), 0u);
+	for(uint64_t v = 1; v <= 10000; ++v)
+		h.record(v);
+	BOOST_CHECK_EQUAL(h.count(), 10000u);
+	BOOST_CHECK_EQUAL(h.max(), 10000u);
+	//exact below HIST_SUB, within 1/HIST_SUB above
+	BOOST_CHECK_EQUAL(h.percentile(0.1), 10u);
+	uint64_t p50 = h.percentile(50), p99 = h.percentile(99);
+	BOOST_CHECK(p50 >= 5000 && p50 <= 5000 + 5000 / HIST_SUB);
+	BOOST_CHECK(p99 >= 9900 && p99 <= 9900 + 9900 / HIST_SUB);
+	BOOST_CHECK_EQUAL(h.percentile(100), 10000u);
+
+	LatencyHistogram other;
+	other.record(1ull << 40);
+	h.merge(other);
+	BOOST_CHECK_EQUAL(h.count(), 10001u);
+	BOOST_CHECK_EQUAL(h.max(), 1ull << 40);
+}
+
+BOOST_AUTO_TEST_CASE(TestOrderFlowIsSeeded) {
+	FlowConfig config;
+	config.seed = 42;
+	config.cancelRatio = 0.25;
+	config.marketableRatio = 0.1;
+	OrderFlow a(config), b(config);
+	FlowMessage ma, mb;
+	int cancels = 0, buys = 0, news = 0, crossing = 0;
+	bool same = true, inRange = true;
+	for(int i = 0; i < 20000; ++i) {
+		a.next(ma);
+		b.next(mb);
+		same = same && ma.type == mb.type && ma.order == mb.order;
+		if(ma.type == LOG_CANCEL) {
+			++cancels;
+			continue;
+		}
+		++news;
+		buys += ma.order.isBuy();
+		inRange = inRange && ma.order.price >= a.minPrice() && ma.order.price <= a.maxPrice();
+		crossing += ma.order.isBuy() ? ma.order.price >= config.mid : ma.order.price <= config.mid;
+	}
+	BOOST_CHECK(same);
+	BOOST_CHECK(inRange);
+	BOOST_CHECK(cancels > 4500 && cancels < 5500);
+	BOOST_CHECK(buys > news * 0.45 && buys < news * 0.55);
+	BOOST_CHECK(crossing > news * 0.08 && crossing < news * 0.12);
+
+	//another seed, another stream
+	config.seed = 43;
+	OrderFlow c(config);
+	config.seed = 42;
+	OrderFlow e(config);
+	bool differs = false;
+	for(int i = 0; i < 100; ++i) {
+		c.next(ma);
+		e.next(mb);
+		differs = differs || ma.type != mb.type || ma.order != mb.order;
+	}
+	BOOST_CHECK(differs);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,178 @@
+/*UNIT TESTS FOR THE MARKET DATA PUBLISHER */
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <unistd.h>
+#include "../src/matchingEngine.h"
+#include "../src/orderFlow.h"
+using namespace std;
+using namespace Matching;
+
+/* Tests covered :
+1. A reader applying the L2 deltas keeps the depth-N view and BBO of the books
+2. A lapped reader is told so and resyncs from a snapshot
+*/
+
+//the depth a reader rebuilds from the ring, levels by price for each side
+struct ReaderBook {
+	map<int, DepthLevel> sides[2]; //asks, bids
+	bool consistent;
+
+	ReaderBook() : consistent(true) {}
+
+	const DepthLevel* best(bool bid) const {
+		const map<int, DepthLevel>& side = sides[bid];
+		if(side.empty())
+			return NULL;
+		return bid ? &side.rbegin()->second : &side.begin()->second;
+	}
+
+	void apply(const MarketDataUpdate& u) {
+		map<int, DepthLevel>& side = sides[u.bid];
+		DepthLevel level = { u.price, (int)u.orders, u.quantity };
+		switch(u.type) {
+		case MD_SNAPSHOT:
+			sides[0].clear();
+			sides[1].clear();
+			break;
+		case MD_LEVEL_NEW:
+			consistent = consistent && side.count(u.price) == 0;
+			side[u.price] = level;
+			break;
+		case MD_LEVEL_CHANGE:
+			consistent = consistent && side.count(u.price) == 1;
+			side[u.price] = level;
+			break;
+		case MD_LEVEL_DELETE:
+			consistent = consistent && side.erase(u.price) == 1;
+			break;
+		case MD_BBO: {
+			const DepthLevel* top = best(u.bid);
+			consistent = consistent && (top == NULL ? u.quantity == 0 : *top == level);
+			break;
+		}
+		}
+	}
+
+	bool same(const OrderBook* book, size_t depth) const {
+		vector<DepthLevel> levels;
+		for(int bid = 0; bid < 2; ++bid) {
+			book->getDepth(bid, depth, levels);
+			if(levels.size() != sides[bid].size())
+				return false;
+			size_t i = 0;
+			if(bid) {
+				for(map<int, DepthLevel>::const_reverse_iterator it = sides[bid].rbegin(); it != sides[bid].rend(); ++it)
+					if(it->second != levels[i++])
+						return false;
+			}
+			else {
+				for(map<int, DepthLevel>::const_iterator it = sides[bid].begin(); it != sides[bid].end(); ++it)
+					if(it->second != levels[i++])
+						return false;
+			}
+		}
+		return true;
+	}
+};
+
+static string ringPath(const char* name) {
+	return string("/tmp/matching_") + name + "_" + to_string(getpid());
+}
+
+BOOST_AUTO_TEST_SUITE( MarketData )
+
+BOOST_AUTO_TEST_CASE(TestDepthDeltas) {
+	FlowConfig flowConfig;
+	flowConfig.seed = 11;
+	OrderFlow flow(flowConfig);
+	SymbolId a = symbolTable().intern("MDA"), b = symbolTable().intern("MDB");
+	size_t depth = 5;
+	string path = ringPath("depth");
+
+	MatchingEngine me;
+	me.bookFor(a);
+	me.bookFor(b);
+	MarketDataPublisher publisher;
+	BOOST_REQUIRE(publisher.open(path, depth));
+	MarketDataReader reader;
+	BOOST_REQUIRE(reader.open(path));
+	BOOST_CHECK_EQUAL(reader.getDepth(), depth);
+	me.setPublisher(&publisher, 7);
+
+	map<SymbolId, ReaderBook> books;
+	MarketDataUpdate updates[256];
+	uint64_t lastBatch = 0;
+	size_t nUpdates = 0;
+	FlowMessage message;
+	for(int i = 0; i < 20000; ++i) {
+		flow.next(message);
+		SymbolId symbol = i % 2 ? a : b;
+		if(message.type == LOG_CANCEL)
+			me.cancelOrder(message.order.id, symbol);
+		else {
+			message.order.symbol = symbol;
+			me.processOrder(me.bookFor(symbol)->newOrder(message.order));
+		}
+		long n;
+		while((n = reader.read(updates, 256)) > 0) {
+			for(long j = 0; j < n; ++j) {
+				BOOST_CHECK(updates[j].batch >= lastBatch);
+				lastBatch = updates[j].batch;
+				books[updates[j].symbol].apply(updates[j]);
+			}
+			nUpdates += n;
+		}
+		BOOST_REQUIRE(n == 0);
+	}
+	me.publishMarketData();
+	long n;
+	while((n = reader.read(updates, 256)) > 0)
+		for(long j = 0; j < n; ++j)
+			books[updates[j].symbol].apply(updates[j]);
+
+	BOOST_CHECK(nUpdates > 0);
+	BOOST_CHECK(books[a].consistent);
+	BOOST_CHECK(books[b].consistent);
+	BOOST_CHECK(books[a].same(me.getOrderBook(a), depth));
+	BOOST_CHECK(books[b].same(me.getOrderBook(b), depth));
+	BOOST_CHECK(!books[a].sides[1].empty());
+	unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestLappedReader) {
+	string path = ringPath("lap");
+	MatchingEngine me;
+	MarketDataPublisher publisher;
+	BOOST_REQUIRE(publisher.open(path, 0, 16));
+	MarketDataReader reader;
+	BOOST_REQUIRE(reader.open(path));
+	me.setPublisher(&publisher);
+	string n1 = "Tree";
+	//every order is a new level, far more updates than the ring holds
+	for(int i = 0; i < 40; ++i)
+		me.processOrder(new Order(i + 1, n1, 100 + i, 10, i + 1, false));
+	MarketDataUpdate updates[16];
+	BOOST_CHECK_EQUAL(reader.read(updates, 16), -1);
+	BOOST_CHECK_EQUAL(reader.read(updates, 16), 0);
+
+	//a snapshot of every level fits in the ring once the book is small
+	for(int i = 0; i < 36; ++i)
+		BOOST_CHECK(me.cancelOrder(i + 1));
+	reader.read(updates, 16);
+	reader.read(updates, 16);
+	publisher.snapshot(DEFAULT_SYMBOL_ID, *me.getOrderBook());
+	publisher.commit();
+	ReaderBook book;
+	long n = reader.read(updates, 16);
+	BOOST_REQUIRE(n > 0);
+	BOOST_CHECK_EQUAL(updates[0].type, MD_SNAPSHOT);
+	for(long j = 0; j < n; ++j)
+		book.apply(updates[j]);
+	BOOST_CHECK(book.consistent);
+	BOOST_CHECK(book.same(me.getOrderBook(), 0));
+	BOOST_CHECK_EQUAL(book.sides[0].size(), 4u);
+	unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
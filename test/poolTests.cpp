@@ -0,0 +1,168 @@
+/*UNIT TESTS FOR THE BOOK POOLS.
+global operator new is replaced by a counting one so the hot path
+can be checked for heap traffic */
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <new>
+#include "../src/matchingEngine.h"
+#include "testUtils.h"
+using namespace std;
+using namespace Matching;
+
+static size_t heapAllocs = 0;
+
+/*every form of the replaceable global new and delete, so each pair the
+program uses matches. the frees are out of line : inlined into a caller
+next to the counted new, gcc would pair operator new with free and warn */
+static void* countedAlloc(size_t size, size_t align) {
+	++heapAllocs;
+	if(size == 0)
+		size = 1;
+	//aligned_alloc wants a whole number of alignments
+	if(align > alignof(max_align_t))
+		return aligned_alloc(align, (size + align - 1) / align * align);
+	return malloc(size);
+}
+
+__attribute__((noinline)) static void countedFree(void* p) noexcept { free(p); }
+
+void* operator new(size_t size) {
+	void* p = countedAlloc(size, 0);
+	if(p == NULL)
+		throw bad_alloc();
+	return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return countedAlloc(size, 0); }
+void* operator new(size_t size, align_val_t align) {
+	void* p = countedAlloc(size, (size_t)align);
+	if(p == NULL)
+		throw bad_alloc();
+	return p;
+}
+void* operator new[](size_t size, align_val_t align) { return operator new(size, align); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { countedFree(p); }
+
+/* Tests covered :
+1. Pool recycling and ownership, across chunks
+2. No heap allocation in steady state add/match/cancel, SIZE_TIME included
+3. Empty books only allocate their ladders
+*/
+
+BOOST_AUTO_TEST_SUITE( Pools )
+
+BOOST_AUTO_TEST_CASE(TestObjectPoolRecycles) {
+	ObjectPool<OrderSlot> pool(4);
+	BOOST_CHECK_EQUAL(pool.capacity(), 4u);
+	OrderSlot* a = pool.create((Order*)NULL, (PriceNode*)NULL);
+	OrderSlot* b = pool.create((Order*)NULL, (PriceNode*)NULL);
+	BOOST_CHECK_EQUAL(pool.inUse(), 2u);
+	BOOST_CHECK(pool.owns(a) && pool.owns(b));
+	pool.destroy(a);
+	//freed blocks are handed out first
+	BOOST_CHECK_EQUAL(pool.create((Order*)NULL, (PriceNode*)NULL), a);
+	OrderSlot outside((Order*)NULL, (PriceNode*)NULL);
+	BOOST_CHECK(!pool.owns(&outside));
+	//running out grows the pool instead of failing
+	for(int i = 0; i < 10; ++i)
+		pool.create((Order*)NULL, (PriceNode*)NULL);
+	BOOST_CHECK(pool.capacity() >= 12u);
+
+	//ownership holds across every chunk, the heap blocks in between are not ours
+	vector<OrderSlot*> pooled;
+	vector<OrderSlot*> heap;
+	for(int i = 0; i < 5000; ++i) {
+		pooled.push_back(pool.create((Order*)NULL, (PriceNode*)NULL));
+		if(i % 1000 == 0)
+			heap.push_back(new OrderSlot((Order*)NULL, (PriceNode*)NULL));
+	}
+	bool allOwned = true;
+	for(OrderSlot* slot : pooled)
+		allOwned = allOwned && pool.owns(slot);
+	BOOST_CHECK(allOwned);
+	for(OrderSlot* slot : heap) {
+		BOOST_CHECK(!pool.owns(slot));
+		delete slot;
+	}
+}
+
+static void steadyStateFlow(OrderBook* book, int round) {
+	int base = round * 100;
+	//two levels each side, then a sweep and some cancels
+	for(int i = 0; i < 10; ++i) {
+		book->add(book->newOrder(base + i, "Mal", 100 - (i & 1), 10, base + i, true));
+		book->add(book->newOrder(base + 10 + i, "Kate", 102 + (i & 1), 10, base + 10 + i, false));
+	}
+	Order* buy = book->newOrder(base + 20, "Mal", 103, 150, base + 20, true);
+	int qtyToMatch = buy->quantity;
+	book->match(buy, qtyToMatch);
+	if(qtyToMatch > 0)
+		book->add(buy);
+	for(int i = 0; i < 10; ++i)
+		book->cancel(base + i);
+	book->cancel(base + 20);
+	book->cancel(base + 19);
+}
+
+static void checkNoHeapInSteadyState(const BookConfig& config) {
+	OrderBook book(config);
+	book.bookTradeForTrader({"Mal", "Kate"});
+	steadyStateFlow(&book, 0);
+
+	size_t before = heapAllocs;
+	for(int round = 1; round < 100; ++round)
+		steadyStateFlow(&book, round);
+	BOOST_CHECK_EQUAL(heapAllocs - before, 0u);
+	BOOST_CHECK_EQUAL(book.getTraderExposure("Mal"), 10000);
+	BOOST_CHECK_EQUAL(book.getTraderExposure("Kate"), -10000);
+	BOOST_CHECK(book.getBids()->empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestNoHeapInSteadyStateTree) {
+	BookConfig config;
+	config.orderCapacity = 64;
+	config.levelCapacity = 16;
+	checkNoHeapInSteadyState(config);
+}
+
+BOOST_AUTO_TEST_CASE(TestNoHeapInSteadyStateArray) {
+	BookConfig config(PRICE_TIME, ARRAY_LADDER, 0, 256);
+	config.orderCapacity = 64;
+	config.levelCapacity = 16;
+	checkNoHeapInSteadyState(config);
+}
+
+//the size-time index of each level lives in the book's arena too
+BOOST_AUTO_TEST_CASE(TestNoHeapInSteadyStateSizeTime) {
+	BookConfig config(SIZE_TIME);
+	config.orderCapacity = 64;
+	config.levelCapacity = 16;
+	checkNoHeapInSteadyState(config);
+}
+
+//an engine with thousands of idle symbols pays for the book and its two ladders only
+BOOST_AUTO_TEST_CASE(TestEmptyBookFootprint) {
+	size_t before = heapAllocs;
+	OrderBook* tree = new OrderBook();
+	BOOST_CHECK_LE(heapAllocs - before, 3u);
+
+	before = heapAllocs;
+	OrderBook* array = new OrderBook(BookConfig(PRICE_TIME, ARRAY_LADDER, 0, 1 << 16));
+	BOOST_CHECK_LE(heapAllocs - before, 3u);
+	delete tree;
+	delete array;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
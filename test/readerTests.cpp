@@ -0,0 +1,485 @@
+/*UNIT TESTS FOR THE ORDER READERS */
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "../src/csvReader.h"
+#include "../src/binaryLog.h"
+#include "../src/matchingEngine.h"
+#include "../src/journal.h"
+#include "../src/orderFlow.h"
+#include "testUtils.h"
+using namespace std;
+using namespace Matching;
+
+/* Tests covered :
+1. Integer and fixed point price fields, order TYPE column
+2. Bad lines are skipped with their line number
+3. Binary log round trip and replay
+4. SYMBOL column routes CSV and binary orders to their books
+5. Snapshot restore, then replay of the log tail
+6. Journal recovery rebuilds the same books, a torn journal recovers its prefix
+7. A failed journal commit stops the durable count
+8. Binary log records with a bad type or an index outside the tables are skipped,
+   a header whose record count does not fit the file is refused
+9. Risk limit changes are journaled, recovery rejects what the live engine rejected
+*/
+
+//writes text to a temporary file, removed when the object goes away
+struct TempFile {
+	string path;
+	TempFile(const string& text) {
+		char name[] = "/tmp/matchingXXXXXX";
+		int fd = mkstemp(name);
+		path = name;
+		FILE* f = fdopen(fd, "w");
+		fwrite(text.data(), 1, text.size(), f);
+		fclose(f);
+	}
+	~TempFile() { unlink(path.c_str()); }
+};
+
+BOOST_AUTO_TEST_SUITE( Readers )
+
+BOOST_AUTO_TEST_CASE(TestFieldParsers) {
+	int64_t v;
+	BOOST_CHECK(parseInt("70000001", v) && v == 70000001);
+	BOOST_CHECK(parseInt("-42", v) && v == -42);
+	BOOST_CHECK(!parseInt("", v));
+	BOOST_CHECK(!parseInt("12a", v));
+	BOOST_CHECK(!parseInt("-", v));
+
+	int price;
+	BOOST_CHECK(parsePrice("100", price) && price == 100 * PRICE_SCALE);
+	BOOST_CHECK(parsePrice("73.11", price) && price == 7311);
+	BOOST_CHECK(parsePrice("73.5", price) && price == 7350);
+	BOOST_CHECK(parsePrice("0.01", price) && price == 1);
+	BOOST_CHECK(!parsePrice("73.111", price));
+	BOOST_CHECK(!parsePrice("73.", price));
+	BOOST_CHECK(!parsePrice("-1", price));
+	BOOST_CHECK(!parsePrice("-0.50", price));
+	BOOST_CHECK(!parsePrice("-0", price));
+	BOOST_CHECK(!parsePrice("1e3", price));
+}
+
+BOOST_AUTO_TEST_CASE(TestCsvReaderSkipsBadLines) {
+	TempFile file("1,Poonam,100.5,150,1,BUY\r\n"
+		"2,AVeryLongTraderNameThatOverflowsTwentyChars,200,200,2,SELL\n"
+		"3,Tree,abc,350,3,SELL\n"
+		"\n"
+		"4,Tree,50,0,4,SELL\n"
+		"5,Tree,50,10,5,HOLD\n"
+		"6,Tree,50,10,6,SELL,ACME,extra\n"
+		"7,Tree,50,10,7,SELL\n"
+		"8,Tree,50,10,8,BUY,ACME,FOK");
+	CsvOrderReader reader;
+	BOOST_REQUIRE(reader.open(file.path));
+
+	Order order;
+	BOOST_REQUIRE(reader.next(order));
+	BOOST_CHECK_EQUAL(order.id, 1);
+	BOOST_CHECK_EQUAL(order.price, 10050);
+	BOOST_CHECK_EQUAL(order.quantity, 150);
+	BOOST_CHECK(order.isBuy());
+	BOOST_CHECK_EQUAL(order.name(), "Poonam");
+
+	BOOST_REQUIRE(reader.next(order));
+	BOOST_CHECK_EQUAL(order.name(), "AVeryLongTraderNameThatOverflowsTwentyChars");
+	BOOST_CHECK(!order.isBuy());
+
+	//lines 3, 5, 6 and 7 are bad, the empty line 4 is skipped
+	BOOST_REQUIRE(reader.next(order));
+	BOOST_CHECK_EQUAL(order.id, 7);
+	BOOST_CHECK_EQUAL(reader.getLineNumber(), 8u);
+	BOOST_CHECK_EQUAL(reader.getBadLines(), 4u);
+	BOOST_CHECK(!(order.flags & ORDER_TIF_MASK));
+	//an unknown TYPE is bad, a known one sets the time in force
+	BOOST_REQUIRE(reader.next(order));
+	BOOST_CHECK_EQUAL(order.flags, ORDER_BUY | ORDER_FOK);
+	BOOST_CHECK(!reader.next(order));
+}
+
+BOOST_AUTO_TEST_CASE(TestRunRejectsBadLines) {
+	TempFile file("1,Poonam,100,150,1,BUY\n"
+		"2,Tree,1xx,350,3,SELL\n"
+		"3,Tree,50,100,3,SELL\n");
+	MatchingEngine me;
+	BOOST_CHECK_EQUAL(me.run(file.path), 0);
+	//the bad sell never traded
+	BOOST_CHECK_EQUAL(const_cast<OrderBook*>(me.getOrderBook())->getTraderExposure(TRADER), 100);
+	BOOST_CHECK_EQUAL(me.run("/nonexistent/orders.csv"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryLogReplay) {
+	TempFile file("");
+	{
+		BinaryLogWriter writer;
+		BOOST_REQUIRE(writer.open(file.path, {"DEFAULT"}, {"Mal", "Kate", "Rob"}));
+		//records use the trader index of the file, not the process ids
+		LogRecord b1 = { LOG_NEW, ORDER_BUY, 0, 0, 1, 1, 10000, 100 };
+		LogRecord b2 = { LOG_NEW, ORDER_BUY, 0, 1, 2, 2, 10000, 200 };
+		LogRecord c1 = { LOG_CANCEL, 0, 0, 0, 1, 3, 0, 0 };
+		LogRecord r2 = { LOG_REPLACE, 0, 0, 0, 2, 4, 10100, 150 };
+		LogRecord s1 = { LOG_NEW, 0, 0, 2, 3, 5, 10000, 400 };
+		LogRecord records[] = { b1, b2, c1, r2, s1 };
+		for(const LogRecord& r : records)
+			BOOST_CHECK(writer.append(r));
+		BOOST_CHECK(writer.close());
+	}
+
+	BinaryLogReader reader;
+	BOOST_REQUIRE(reader.open(file.path));
+	BOOST_CHECK_EQUAL(reader.size(), 5u);
+	BOOST_CHECK_EQUAL(reader.getInstruments()[0], "DEFAULT");
+	BOOST_CHECK_EQUAL(reader.getTraders()[2], "Rob");
+
+	MatchingEngine me;
+	me.init({"Mal", "Kate", "Rob"});
+	BOOST_CHECK_EQUAL(me.replay(file.path), 0);
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure("Mal"), 0);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure("Kate"), 150);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure("Rob"), -150);
+	const Order* rest = orderBook->getAsks()->best()->getQueue().front()->order;
+	BOOST_CHECK_EQUAL(rest->id, 3);
+	BOOST_CHECK_EQUAL(rest->quantity, 250);
+
+	BOOST_CHECK(!reader.open("/nonexistent/orders.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(TestCsvToBinaryMatchesCsvRun) {
+	TempFile csv("1,Poonam,100,150,1,BUY\n"
+		"2,Srajan,200,200,2,BUY\n"
+		"3,Tree,50,350,3,SELL\n"
+		"4,Poonam,100.5,50,4,BUY\n"
+		"5,Tree,100.25,80,5,SELL\n");
+	TempFile bin("");
+	BOOST_CHECK_EQUAL(csvToBinary(csv.path, bin.path, "DEFAULT"), 5);
+
+	MatchingEngine fromCsv, fromBin;
+	BOOST_CHECK_EQUAL(fromCsv.run(csv.path), 0);
+	BOOST_CHECK_EQUAL(fromBin.replay(bin.path), 0);
+	const OrderBook* a = fromCsv.getOrderBook();
+	const OrderBook* b = fromBin.getOrderBook();
+	BOOST_CHECK_EQUAL(const_cast<OrderBook*>(a)->getTraderExposure(TRADER),
+		const_cast<OrderBook*>(b)->getTraderExposure(TRADER));
+	BOOST_CHECK(a->getBids()->empty() && b->getBids()->empty());
+	BOOST_REQUIRE(a->getAsks()->size() == 1 && b->getAsks()->size() == 1);
+	BOOST_CHECK(*a->getAsks()->best()->getQueue().front()->order == *b->getAsks()->best()->getQueue().front()->order);
+}
+
+BOOST_AUTO_TEST_CASE(TestSymbolColumn) {
+	TempFile csv("1,Poonam,100,150,1,BUY,ACME\n"
+		"2,Srajan,90,200,2,SELL,WDGT\n"
+		"3,Tree,100,50,3,SELL\n"
+		"4,Tree,100,100,4,SELL,ACME\n"
+		"5,Tree,100,100,5,SELL,\n");
+	CsvOrderReader reader;
+	BOOST_REQUIRE(reader.open(csv.path));
+	Order order;
+	BOOST_CHECK(reader.next(order));
+	BOOST_CHECK_EQUAL(symbolTable().name(order.symbol), "ACME");
+	BOOST_CHECK(reader.next(order) && reader.next(order));
+	BOOST_CHECK_EQUAL(order.symbol, DEFAULT_SYMBOL_ID);
+	BOOST_CHECK(reader.next(order));
+	//an empty SYMBOL is a bad line
+	BOOST_CHECK(!reader.next(order));
+	BOOST_CHECK_EQUAL(reader.getBadLines(), 1u);
+
+	TempFile bin("");
+	BOOST_CHECK_EQUAL(csvToBinary(csv.path, bin.path, "DEFAULT"), 4);
+	BinaryLogReader log;
+	BOOST_REQUIRE(log.open(bin.path));
+	BOOST_CHECK_EQUAL(log.getInstruments().size(), 3u);
+
+	MatchingEngine fromCsv, fromBin;
+	BOOST_CHECK_EQUAL(fromCsv.run(csv.path), 0);
+	BOOST_CHECK_EQUAL(fromBin.replay(bin.path), 0);
+	BOOST_CHECK_EQUAL(fromCsv.getTraderExposure(TRADER), 100);
+	BOOST_CHECK_EQUAL(fromBin.getTraderExposure(TRADER), 100);
+	SymbolId acme = symbolTable().find("ACME"), wdgt = symbolTable().find("WDGT");
+	const OrderBook* books[] = { fromCsv.getOrderBook(acme), fromBin.getOrderBook(acme) };
+	for(const OrderBook* book : books) {
+		BOOST_REQUIRE(book != NULL);
+		BOOST_CHECK_EQUAL(book->getBids()->best()->getQueue().front()->order->quantity, 50);
+		BOOST_CHECK(book->getAsks()->empty());
+	}
+	BOOST_CHECK_EQUAL(fromBin.getOrderBook(wdgt)->getAsks()->size(), 1u);
+	BOOST_CHECK_EQUAL(fromBin.getOrderBook()->getAsks()->size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(TestSnapshotRestore) {
+	//a log over two instruments with cancels
+	FlowConfig flowConfig;
+	flowConfig.seed = 5;
+	OrderFlow flow(flowConfig);
+	TempFile bin("");
+	size_t nRecords = 20000, cut = 12000;
+	{
+		vector<string> traders;
+		for(int i = 0; i < flowConfig.nTraders; ++i)
+			traders.push_back("flow" + to_string(i));
+		BinaryLogWriter writer;
+		BOOST_REQUIRE(writer.open(bin.path, {"SNAPA", "SNAPB"}, traders));
+		FlowMessage message;
+		for(size_t i = 0; i < nRecords; ++i) {
+			flow.next(message);
+			LogRecord record = newRecord(message.order, i % 2);
+			record.type = message.type;
+			record.trader = message.order.trader - traderTable().find("flow0");
+			writer.append(record);
+		}
+		BOOST_CHECK(writer.close());
+	}
+	vector<string> names{"flow0", "flow3"};
+	BookConfig arrayConfig(SIZE_TIME, ARRAY_LADDER, flow.minPrice(), flow.maxPrice() - flow.minPrice() + 1);
+
+	MatchingEngine full;
+	full.init(names);
+	full.addInstrument("SNAPA", arrayConfig);
+	BOOST_CHECK_EQUAL(full.replay(bin.path), 0);
+	BOOST_CHECK_EQUAL(full.getSequence(), nRecords);
+
+	//the same log stopped at cut, snapshotted, restored and finished
+	TempFile head(""), snap("");
+	{
+		BinaryLogReader reader;
+		BOOST_REQUIRE(reader.open(bin.path));
+		BinaryLogWriter writer;
+		BOOST_REQUIRE(writer.open(head.path, reader.getInstruments(), reader.getTraders()));
+		for(size_t i = 0; i < cut; ++i)
+			writer.append(reader.begin()[i]);
+		BOOST_CHECK(writer.close());
+	}
+	{
+		MatchingEngine first;
+		first.init(names);
+		first.addInstrument("SNAPA", arrayConfig);
+		BOOST_CHECK_EQUAL(first.replay(head.path), 0);
+		BOOST_CHECK(first.saveSnapshot(snap.path));
+	}
+	MatchingEngine restored;
+	BOOST_REQUIRE(restored.loadSnapshot(snap.path));
+	BOOST_CHECK_EQUAL(restored.getSequence(), cut);
+	SymbolId a = symbolTable().find("SNAPA"), b = symbolTable().find("SNAPB");
+	BOOST_CHECK(restored.getOrderBook(a)->getConfig().ladder == ARRAY_LADDER);
+	BOOST_CHECK(restored.getOrderBook(a)->getPriority() == SIZE_TIME);
+	BOOST_CHECK(!restored.getOrderBook(b)->getBids()->empty());
+	BOOST_CHECK_EQUAL(restored.replay(bin.path), 0);
+	BOOST_CHECK_EQUAL(restored.getSequence(), nRecords);
+
+	BOOST_CHECK(sameBook(full.getOrderBook(a), restored.getOrderBook(a)));
+	BOOST_CHECK(sameBook(full.getOrderBook(b), restored.getOrderBook(b)));
+	for(const string& name : names)
+		BOOST_CHECK_EQUAL(full.getTraderExposure(name), restored.getTraderExposure(name));
+	BOOST_CHECK(full.getTraderExposure("flow0") != 0);
+
+	BOOST_CHECK(!restored.loadSnapshot(bin.path));
+}
+
+//whole file as a string
+static string readAll(const string& path) {
+	ifstream in(path, ios::binary);
+	return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryLogBadRecords) {
+	TempFile file("");
+	{
+		BinaryLogWriter writer;
+		BOOST_REQUIRE(writer.open(file.path, {"DEFAULT"}, {"Mal", "Kate"}));
+		LogRecord records[] = {
+			{ LOG_NEW, ORDER_BUY, 0, 0, 1, 1, 10000, 100 },
+			{ LOG_NEW, ORDER_BUY, 0, 2, 2, 2, 10000, 100 }, //no trader 2
+			{ LOG_CANCEL, 0, 1, 0, 1, 3, 0, 0 }, //no instrument 1
+			{ LOG_PEAK, 0, 0, 0, 0, 4, 0, 10 }, //journal only
+			{ LOG_NEW, 0, 0, 1, 3, 5, 10000, 60 }
+		};
+		for(const LogRecord& r : records)
+			BOOST_CHECK(writer.append(r));
+		BOOST_CHECK(writer.close());
+	}
+	MatchingEngine me;
+	me.init({"Mal", "Kate"});
+	BOOST_CHECK_EQUAL(me.replay(file.path), 0);
+	//the bad ones still count, the log and the sequence stay aligned
+	BOOST_CHECK_EQUAL(me.getSequence(), 5u);
+	BOOST_CHECK_EQUAL(me.getTraderExposure("Mal"), 60);
+	BOOST_CHECK_EQUAL(me.getTraderExposure("Kate"), -60);
+	const OrderBook* book = me.getOrderBook();
+	BOOST_CHECK_EQUAL(book->getBids()->best()->getQuantity(), 40);
+	BOOST_CHECK_EQUAL(book->getBids()->best()->getOrderCount(), 1);
+
+	//a record count whose byte size wraps around to the file size
+	uint64_t count = 5 + (1ULL << 59);
+	FILE* f = fopen(file.path.c_str(), "r+b");
+	BOOST_REQUIRE(f != NULL);
+	BOOST_CHECK(fseek(f, offsetof(LogHeader, recordCount), SEEK_SET) == 0);
+	BOOST_CHECK(fwrite(&count, sizeof(count), 1, f) == 1);
+	fclose(f);
+	BinaryLogReader reader;
+	BOOST_CHECK(!reader.open(file.path));
+	BOOST_CHECK_EQUAL(me.replay(file.path), -1);
+}
+
+BOOST_AUTO_TEST_CASE(TestJournalRecovery) {
+	FlowConfig flowConfig;
+	flowConfig.seed = 9;
+	OrderFlow flow(flowConfig);
+	vector<string> names{"flow1", "flow2"};
+	SymbolId a = symbolTable().intern("JRNLA"), b = symbolTable().intern("JRNLB");
+	size_t nMessages = 20000;
+
+	TempFile journalFile("");
+	MatchingEngine live;
+	live.init(names);
+	Journal journal;
+	JournalConfig journalConfig;
+	journalConfig.batchRecords = 64;
+	journalConfig.sync = false;
+	BOOST_REQUIRE(journal.open(journalFile.path, journalConfig));
+	live.setJournal(&journal);
+	FlowMessage message;
+	for(size_t i = 0; i < nMessages; ++i) {
+		flow.next(message);
+		SymbolId symbol = i % 3 ? a : b;
+		if(message.type == LOG_CANCEL)
+			live.cancelOrder(message.order.id, symbol);
+		else {
+			message.order.symbol = symbol;
+			//every tenth order is an iceberg
+			live.processOrder(live.bookFor(symbol)->newOrder(message.order), i % 10 ? 0 : 3);
+		}
+	}
+	BOOST_CHECK_EQUAL(journal.getAppended(), nMessages);
+	BOOST_CHECK(journal.close());
+	BOOST_CHECK_EQUAL(journal.getDurable(), nMessages);
+
+	//the recovered engine snapshots to the same bytes
+	MatchingEngine recovered;
+	recovered.init(names);
+	BOOST_CHECK_EQUAL(recovered.recover(journalFile.path), (int64_t)nMessages);
+	TempFile liveSnap(""), recoveredSnap("");
+	BOOST_REQUIRE(live.saveSnapshot(liveSnap.path));
+	BOOST_REQUIRE(recovered.saveSnapshot(recoveredSnap.path));
+	BOOST_CHECK(readAll(liveSnap.path) == readAll(recoveredSnap.path));
+	BOOST_CHECK(live.getTraderExposure("flow1") != 0);
+
+	//a crash in the middle of a write leaves a torn record, the rest recovers
+	string bytes = readAll(journalFile.path);
+	TempFile torn(bytes.substr(0, bytes.size() - sizeof(LogRecord) / 2));
+	MatchingEngine partial;
+	partial.init(names);
+	BOOST_CHECK_EQUAL(partial.recover(torn.path), (int64_t)nMessages - 1);
+
+	BOOST_CHECK_EQUAL(partial.recover(liveSnap.path), -1);
+}
+
+BOOST_AUTO_TEST_CASE(TestJournalRiskLimits) {
+	vector<string> names{"Mal", "Kate"};
+	TempFile journalFile("");
+	MatchingEngine live;
+	live.init(names);
+	Journal journal;
+	JournalConfig journalConfig;
+	journalConfig.sync = false;
+	BOOST_REQUIRE(journal.open(journalFile.path, journalConfig));
+	live.setJournal(&journal);
+	EventBuffer events;
+	live.setEventBuffer(&events);
+	//a limit set in the middle of the flow only applies from there on
+	RiskLimits limits = { 20, 0, 0, 0 };
+	int rejected = 0;
+	for(int i = 1; i <= 40; ++i) {
+		if(i == 11)
+			live.setRiskLimits("Mal", limits);
+		if(i == 31) {
+			limits.maxOrderQty = 0;
+			live.setRiskLimits("Mal", limits);
+		}
+		live.processOrder(new Order(i, i % 2 ? "Mal" : "Kate", 100, 5 + i % 4 * 10, i, i % 2));
+		for(const ExecEvent& e : events)
+			rejected += e.type == EVENT_REJECTED;
+		events.clear();
+	}
+	BOOST_CHECK(rejected > 0);
+	BOOST_CHECK_EQUAL(journal.getAppended(), 40u);
+	BOOST_CHECK(journal.close());
+
+	//limits are not set again before recovering
+	MatchingEngine recovered;
+	recovered.init(names);
+	recovered.setEventBuffer(&events);
+	BOOST_CHECK_EQUAL(recovered.recover(journalFile.path), 40);
+	int recoveredRejected = 0;
+	for(const ExecEvent& e : events)
+		recoveredRejected += e.type == EVENT_REJECTED;
+	BOOST_CHECK_EQUAL(recoveredRejected, rejected);
+	BOOST_CHECK_EQUAL(recovered.getSequence(), live.getSequence());
+	TempFile liveSnap(""), recoveredSnap("");
+	BOOST_REQUIRE(live.saveSnapshot(liveSnap.path));
+	BOOST_REQUIRE(recovered.saveSnapshot(recoveredSnap.path));
+	BOOST_CHECK(readAll(liveSnap.path) == readAll(recoveredSnap.path));
+
+	//a batch of journal records takes the limits the same way
+	MatchingEngine batched;
+	batched.init(names);
+	batched.setEventBuffer(&events);
+	events.clear();
+	LogRecord records[3];
+	memset(records, 0, sizeof(records));
+	records[0].type = LOG_RISK_LIMITS;
+	records[0].trader = traderTable().find("Mal");
+	RiskLimits small = { 1, 0, 0, 0 };
+	memcpy(&records[1], &small, sizeof(small));
+	Order order(1, "Mal", 100, 5, 1, true);
+	records[2] = newRecord(order);
+	BOOST_CHECK_EQUAL(batched.processBatch(records, 3), 1u);
+	BOOST_REQUIRE(!events.empty());
+	BOOST_CHECK_EQUAL(events[0].type, EVENT_REJECTED);
+}
+
+//the file size limit makes the writes past 8 KB fail with EFBIG
+BOOST_AUTO_TEST_CASE(TestJournalFailure) {
+	TempFile journalFile("");
+	Journal journal;
+	JournalConfig journalConfig;
+	journalConfig.batchRecords = 16;
+	journalConfig.sync = false;
+	BOOST_REQUIRE(journal.open(journalFile.path, journalConfig));
+	struct rlimit saved, limit;
+	getrlimit(RLIMIT_FSIZE, &saved);
+	limit = saved;
+	limit.rlim_cur = 8192;
+	signal(SIGXFSZ, SIG_IGN);
+	setrlimit(RLIMIT_FSIZE, &limit);
+
+	Order order(1, "Tree", 100, 10, 1, true);
+	uint64_t n = 0;
+	for(int spins = 0; !journal.hasFailed() && spins < 1000000; ++spins) {
+		order.id = ++n;
+		journal.append(newRecord(order));
+		if(n % 16 == 0)
+			usleep(100);
+	}
+	BOOST_REQUIRE(journal.hasFailed());
+	uint64_t durable = journal.getDurable();
+	BOOST_CHECK(durable < n);
+	BOOST_CHECK(durable * sizeof(LogRecord) <= 8192);
+	//later batches are not counted either
+	for(int i = 0; i < 1000; ++i) {
+		order.id = ++n;
+		journal.append(newRecord(order));
+	}
+	BOOST_CHECK(!journal.close());
+	BOOST_CHECK_EQUAL(journal.getDurable(), durable);
+	BOOST_CHECK_EQUAL(journal.getAppended(), n);
+
+	setrlimit(RLIMIT_FSIZE, &saved);
+	signal(SIGXFSZ, SIG_DFL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,214 @@
+/*UNIT TESTS FOR THE SHARDED ENGINE */
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <unistd.h>
+#include "../src/shardedEngine.h"
+#include "testUtils.h"
+using namespace std;
+using namespace Matching;
+
+/* Tests covered :
+1. SPSC ring wrap around, full and empty, across two threads
+2. Sharded matching gives the books and exposures of a single engine
+3. Merged results keep the order of every instrument
+4. A sharded replay skips the records a binary log reader rejects
+5. Forwarded events merge into the per instrument stream of a single engine
+*/
+
+BOOST_AUTO_TEST_SUITE( Shards )
+
+BOOST_AUTO_TEST_CASE(TestSpscQueue) {
+	SpscQueue<int> ring(3);
+	BOOST_CHECK_EQUAL(ring.capacity(), 4u);
+	int v;
+	BOOST_CHECK(!ring.pop(v));
+	for(int i = 0; i < 4; ++i)
+		BOOST_CHECK(ring.push(i));
+	BOOST_CHECK(!ring.push(4));
+	BOOST_CHECK(ring.pop(v) && v == 0);
+	BOOST_CHECK(ring.push(4));
+	for(int i = 1; i < 5; ++i)
+		BOOST_CHECK(ring.pop(v) && v == i);
+	BOOST_CHECK(ring.empty());
+
+	//a small ring forces both sides through the full and empty paths
+	const int n = 100000;
+	thread producer([&ring]() {
+		SpinWait wait;
+		for(int i = 0; i < n; ++i)
+			while(!ring.push(i))
+				wait();
+	});
+	bool inOrder = true;
+	SpinWait wait;
+	for(int i = 0; i < n; ++i) {
+		while(!ring.pop(v))
+			wait();
+		inOrder = inOrder && v == i;
+	}
+	producer.join();
+	BOOST_CHECK(inOrder);
+}
+
+//a few crossing orders on each of nSymbols instruments
+static vector<Order> multiSymbolFlow(int nSymbols, int nOrders) {
+	vector<SymbolId> symbols;
+	for(int i = 0; i < nSymbols; ++i)
+		symbols.push_back(symbolTable().intern("SHARD" + to_string(i)));
+	TraderId mal = traderTable().intern("Mal"), kate = traderTable().intern("Kate");
+	vector<Order> orders;
+	for(int i = 0; i < nOrders; ++i) {
+		bool isBuy = (i / 3) & 1;
+		int price = 100 + (i * 7) % 5 - (isBuy ? 0 : 1);
+		orders.push_back(Order(i, isBuy ? mal : kate, price, 10 + i % 20, i, isBuy, symbols[i % nSymbols]));
+	}
+	return orders;
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedMatchesSingleEngine) {
+	vector<Order> orders = multiSymbolFlow(7, 5000);
+	MatchingEngine single;
+	single.init({"Mal", "Kate"});
+	for(const Order& order : orders)
+		single.processOrder(new Order(order));
+
+	//a tiny ring so the dispatcher has to wait on full rings
+	ShardedEngine sharded(3, BookConfig(), 8);
+	sharded.init({"Mal", "Kate"});
+	sharded.start();
+	vector<ShardResult> results;
+	auto sink = [&results](const ShardResult& result) { results.push_back(result); };
+	for(size_t i = 0; i < orders.size(); ++i) {
+		sharded.submit(LOG_NEW, orders[i]);
+		if(i % 100 == 0)
+			sharded.poll(sink);
+	}
+	//rests far from the market, then goes away again
+	Order far(9999, orders[0].trader, 50, 10, 9999, true, orders[0].symbol);
+	sharded.submit(LOG_NEW, far);
+	sharded.submit(LOG_CANCEL, far);
+	sharded.stop();
+	sharded.poll(sink);
+
+	BOOST_CHECK_EQUAL(results.size(), orders.size() + 2);
+	BOOST_CHECK_EQUAL(sharded.getTraderExposure("Mal"), single.getTraderExposure("Mal"));
+	BOOST_CHECK_EQUAL(sharded.getTraderExposure("Kate"), single.getTraderExposure("Kate"));
+	BOOST_CHECK(single.getTraderExposure("Mal") != 0);
+	for(int s = 0; s < 7; ++s) {
+		SymbolId symbol = symbolTable().find("SHARD" + to_string(s));
+		const OrderBook* a = single.getOrderBook(symbol);
+		const OrderBook* b = sharded.getOrderBook(symbol);
+		BOOST_REQUIRE(a != NULL && b != NULL);
+		BOOST_CHECK_EQUAL(a->getBids()->size(), b->getBids()->size());
+		BOOST_CHECK_EQUAL(a->getAsks()->size(), b->getAsks()->size());
+		if(!a->getBids()->empty())
+			BOOST_CHECK(*a->getBids()->best()->getQueue().front()->order == *b->getBids()->best()->getQueue().front()->order);
+	}
+
+	//per instrument the results come back in submission order
+	vector<uint64_t> next(symbolTable().size(), 0);
+	bool inOrder = true;
+	int filled = 0, cancelled = 0;
+	for(const ShardResult& result : results) {
+		inOrder = inOrder && result.seq == next[result.symbol]++;
+		filled += result.filled;
+		cancelled += result.type == LOG_CANCEL && result.ok;
+	}
+	BOOST_CHECK(inOrder);
+	BOOST_CHECK(filled > 0);
+	BOOST_CHECK_EQUAL(cancelled, 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedReplayBadRecords) {
+	string path = "/tmp/matching_shard_" + to_string(getpid()) + ".bin";
+	{
+		BinaryLogWriter writer;
+		BOOST_REQUIRE(writer.open(path, {"SHARDBAD0", "SHARDBAD1"}, {"Mal", "Kate"}));
+		LogRecord records[] = {
+			{ LOG_NEW, ORDER_BUY, 0, 0, 1, 1, 100, 50 },
+			{ LOG_NEW, 0, 1, 5, 2, 2, 100, 50 }, //no trader 5
+			{ LOG_CANCEL, 0, 9, 0, 1, 3, 0, 0 }, //no instrument 9
+			{ LOG_NEW, 0, 0, 1, 3, 4, 100, 20 }
+		};
+		for(const LogRecord& r : records)
+			BOOST_CHECK(writer.append(r));
+		BOOST_CHECK(writer.close());
+	}
+	ShardedEngine sharded(2);
+	sharded.init({"Mal", "Kate"});
+	BOOST_CHECK_EQUAL(sharded.replay(path), 0);
+	unlink(path.c_str());
+	BOOST_CHECK_EQUAL(sharded.getTraderExposure("Mal"), 20);
+	BOOST_CHECK_EQUAL(sharded.getTraderExposure("Kate"), -20);
+}
+
+//field by field, the padding is never written
+static bool sameEvent(const ExecEvent& a, const ExecEvent& b) {
+	return a.type == b.type && a.reason == b.reason && a.flags == b.flags && a.symbol == b.symbol &&
+		a.trader == b.trader && a.contraTrader == b.contraTrader && a.id == b.id && a.contraId == b.contraId &&
+		a.price == b.price && a.quantity == b.quantity && a.leaves == b.leaves;
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedEventsMatchSingleEngine) {
+	vector<Order> orders = multiSymbolFlow(5, 3000);
+	MatchingEngine single;
+	single.init({"Mal", "Kate"});
+	EventBuffer buffer;
+	single.setEventBuffer(&buffer);
+	vector<vector<ExecEvent> > expected(symbolTable().size());
+	for(const Order& order : orders) {
+		single.processOrder(new Order(order));
+		for(const ExecEvent& e : buffer)
+			expected[e.symbol].push_back(e);
+		buffer.clear();
+	}
+
+	ShardedEngine sharded(3, BookConfig(), 8);
+	sharded.init({"Mal", "Kate"});
+	sharded.setEventForwarding(true);
+	sharded.start();
+	vector<vector<ExecEvent> > merged(symbolTable().size());
+	//a result comes after the events of its message
+	bool eventsFirst = true;
+	int64_t malExposure = 0;
+	TraderId mal = traderTable().find("Mal");
+	auto sink = [&](const ShardResult& result) {
+		const vector<ExecEvent>& events = merged[result.symbol];
+		eventsFirst = eventsFirst && !events.empty() && events.back().id == result.id;
+	};
+	auto eventSink = [&](const ExecEvent& e) {
+		merged[e.symbol].push_back(e);
+		if(e.type == EVENT_TRADE) {
+			bool aggressorBuys = e.flags & ORDER_BUY;
+			if(e.trader == mal)
+				malExposure += aggressorBuys ? e.quantity : -e.quantity;
+			if(e.contraTrader == mal)
+				malExposure += aggressorBuys ? -e.quantity : e.quantity;
+		}
+	};
+	for(size_t i = 0; i < orders.size(); ++i) {
+		sharded.submit(LOG_NEW, orders[i]);
+		if(i % 100 == 0)
+			sharded.poll(sink, eventSink);
+	}
+	sharded.stop();
+	sharded.poll(sink, eventSink);
+
+	BOOST_CHECK(eventsFirst);
+	size_t nEvents = 0;
+	bool same = true;
+	for(size_t s = 0; s < expected.size(); ++s) {
+		nEvents += merged[s].size();
+		same = same && merged[s].size() == expected[s].size();
+		for(size_t i = 0; same && i < merged[s].size(); ++i)
+			same = sameEvent(merged[s][i], expected[s][i]);
+	}
+	BOOST_CHECK(same);
+	BOOST_CHECK(nEvents > orders.size());
+	//the trades carry the account updates
+	BOOST_CHECK(malExposure != 0);
+	BOOST_CHECK_EQUAL(malExposure, sharded.getTraderExposure("Mal"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
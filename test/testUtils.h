@@ -10,13 +10,13 @@ namespace Matching
 	/*Test bid in descending order
 	Test ask in ascending order
 	*/
-	inline bool priceTreeEquals(PriceTree* priceTree, vector<Order*>& orders) {
+	inline bool ladderEquals(const PriceLadder* ladder, vector<Order*>& orders) {
 		//orders is taken by reference to remove cc invocation, no need for pointers while using the function though
 		unsigned int num = 0;
-		for(PriceTreeIt it = priceTree->begin(); it != priceTree->end(); ++it) {
-			OrderTree* orderTree = it->second->getOrderTree();
-			for(OrderTreeIt itOrder = orderTree->begin(); itOrder != orderTree->end(); ++itOrder) {
-				if(num >= orders.size() || *orders[num] != *(*itOrder))
+		for(const PriceNode* level = ladder->best(); level != NULL; level = ladder->next(level->getPrice())) {
+			const OrderQueue& quotes = level->getQueue();
+			for(const OrderSlot* slot = quotes.front(); slot != NULL; slot = slot->next) {
+				if(num >= orders.size() || *orders[num] != *slot->order)
 					return false;
 				++num;
 			}
@@ -28,8 +28,30 @@ namespace Matching
 	/*test if orderBook equals expected */
 	inline bool orderBookEquals(OrderBook* book, vector<Order*> bids, vector<Order*> asks) {
 		//comparing address only?
-		return priceTreeEquals(book->getBidTree(), bids) &&
-		priceTreeEquals(book->getAskTree(), asks);
+		return ladderEquals(book->getBids(), bids) &&
+		ladderEquals(book->getAsks(), asks);
+	}
+
+	//same levels, same queues in the same order, same orders on both ladders
+	inline bool sameLadder(const PriceLadder* a, const PriceLadder* b) {
+		const PriceNode* la = a->best();
+		const PriceNode* lb = b->best();
+		for(; la != NULL && lb != NULL; la = a->next(la->getPrice()), lb = b->next(lb->getPrice())) {
+			if(la->getPrice() != lb->getPrice())
+				return false;
+			const OrderSlot* sa = la->getQueue().front();
+			const OrderSlot* sb = lb->getQueue().front();
+			for(; sa != NULL && sb != NULL; sa = sa->next, sb = sb->next)
+				if(*sa->order != *sb->order)
+					return false;
+			if(sa != NULL || sb != NULL)
+				return false;
+		}
+		return la == NULL && lb == NULL;
+	}
+
+	inline bool sameBook(const OrderBook* a, const OrderBook* b) {
+		return sameLadder(a->getBids(), b->getBids()) && sameLadder(a->getAsks(), b->getAsks());
 	}
 }
 #endif
\ No newline at end of file
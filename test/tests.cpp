@@ -2,7 +2,9 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE TestMatch
 #include <boost/test/unit_test.hpp>
+#include <unistd.h>
 #include "../src/matchingEngine.h"
+#include "../src/orderFlow.h"
 #include "testUtils.h"
 using namespace std;
 
@@ -17,12 +19,31 @@ using namespace std;
 8. Deplete one price level
 9. Deplete multiple price level
 10. Deplete entire tree
+11. Price-time (FIFO) priority within a level
+12. Size-time requeue after a partial fill, a deep level stays sorted through fills, reduces and cancels
+13. Cancel, reduce and replace by order id
+14. Array ladder : level scan, sweep and range limits
+15. Interned trader ids, only registered traders are booked, printed prices
+16. Routing to per-symbol books
+17. Execution events of match, add, cancel and drop
+18. Book stats counters (make test STATS=1)
+19. Level quantity and order count aggregates, depth queries
+20. Cached best bid/ask, spread and quantity available up to a price
+21. IOC, FOK and market orders never rest
+22. Iceberg replenishment and hidden orders (icebergs too), excluded from the depth
+23. Stop and stop-limit orders fire on the last trade price, in trigger order
+24. A batch of records gives the books and events of one call per message
+25. Pro-rata and hybrid allocation, minimum allocation and FIFO rounding lots
+26. Call auction : orders collect crossed, uncross at the equilibrium price
+27. Pre-trade risk limits and price collar reject with an event
+28. Self-trade prevention : cancel newest, oldest, both and decrement,
+    with pro-rata shares and fill-or-kill orders
 */
 
 BOOST_AUTO_TEST_SUITE( Matching )
 
 BOOST_AUTO_TEST_CASE(TestNoMatch) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
 	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
 	me.init({n1,n2,n3});
 	Order* b1 = new Order(1,n1,100,100,1,true);
@@ -41,7 +62,7 @@ BOOST_AUTO_TEST_CASE(TestNoMatch) {
 }
 
 BOOST_AUTO_TEST_CASE(TestOneQuotePartialMatch) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
 	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
 	me.init({n1,n2,n3});
 	Order* b1 = new Order(1,n1,100,100,1,true);
@@ -58,7 +79,7 @@ BOOST_AUTO_TEST_CASE(TestOneQuotePartialMatch) {
 }
 
 BOOST_AUTO_TEST_CASE(TestOneQuoteFullMatch) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
 	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
 	me.init({n1,n2,n3});
 	Order* b1 = new Order(1,n1,100,100,1,true);
@@ -75,7 +96,7 @@ BOOST_AUTO_TEST_CASE(TestOneQuoteFullMatch) {
 }
 
 BOOST_AUTO_TEST_CASE(TestMultipleQuoteFullMatch) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
 	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit", n4 = "Husky", n5 = "Lab";
 	me.init({n1,n2,n3,n4,n5});
 	Order* b1 = new Order(1,n1,100,100,1,true);
@@ -98,7 +119,7 @@ BOOST_AUTO_TEST_CASE(TestMultipleQuoteFullMatch) {
 }
 
 BOOST_AUTO_TEST_CASE(TestMultipleQuoteOutsideMatchWithResidual) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
     string n1 = "Mal", n2 = "Kaylee", n3 = "Tom", n4 = "Kate", n5 = "Rob";
     me.init( {n1, n2, n3, n4, n5 } );
 
@@ -125,7 +146,7 @@ BOOST_AUTO_TEST_CASE(TestMultipleQuoteOutsideMatchWithResidual) {
 
 BOOST_AUTO_TEST_CASE( TestOnePriceLevelMatch )
 {
-    MatchingEngine me;
+    MatchingEngine me(SIZE_TIME);
     string n1 = "Mal", n2 = "Kaylee", n3 = "Tom", n4 = "Kate", n5 = "Rob";
     me.init( {n1, n2, n3, n4, n5 } );
 
@@ -153,7 +174,7 @@ BOOST_AUTO_TEST_CASE( TestOnePriceLevelMatch )
 
 BOOST_AUTO_TEST_CASE( TestMultiplePriceLevelMatch )
 {
-    MatchingEngine me;
+    MatchingEngine me(SIZE_TIME);
     string n1 = "Mal", n2 = "Kaylee", n3 = "Tom", n4 = "Kate", n5 = "Rob", n6 = "Bill";
     me.init( {n1, n2, n3, n4, n5, n6 } );
 
@@ -182,7 +203,7 @@ BOOST_AUTO_TEST_CASE( TestMultiplePriceLevelMatch )
 }
 
 BOOST_AUTO_TEST_CASE(TestEntireTreeMatch) {
-	MatchingEngine me;
+	MatchingEngine me(SIZE_TIME);
 	string n1 = "Mal", n2 = "Kaylee", n3 = "Tom", n4 = "Kate", n5 = "Rob", n6 = "Bill";
     me.init( {n1, n2, n3, n4, n5, n6 } );
     Order* b1 = new Order(1,n1,200,100,1,true);
@@ -202,4 +223,1004 @@ BOOST_AUTO_TEST_CASE(TestEntireTreeMatch) {
     BOOST_CHECK( orderBookEquals( orderBook, {}, {s2} ) );
 }
 
-BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
+BOOST_AUTO_TEST_CASE(TestFifoPriorityAtLevel) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	Order* b1 = new Order(1,n1,100,100,1,true);
+	Order* b2 = new Order(2,n2,100,200,2,true);
+	me.processOrder(b1);
+	me.processOrder(b2);
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+	BOOST_CHECK(orderBookEquals(orderBook,{b1,b2},{}));
+
+	Order* s1 = new Order(3,n3,80,150,3,false);
+	me.processOrder(s1);
+	BOOST_CHECK(orderBookEquals(orderBook,{b2},{}));
+	BOOST_CHECK_EQUAL(b2->quantity,150);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n1),100);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n2),50);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n3),-150);
+}
+
+BOOST_AUTO_TEST_CASE(TestSizeTimeRequeueAfterPartialFill) {
+	MatchingEngine me(SIZE_TIME);
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	Order* b1 = new Order(1,n1,100,300,1,true);
+	Order* b2 = new Order(2,n2,100,200,2,true);
+	Order* s1 = new Order(3,n3,100,150,3,false);
+	me.processOrder(b1);
+	me.processOrder(b2);
+	me.processOrder(s1);
+	//b1 is left with 150 so b2 now has the bigger size
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+	BOOST_CHECK(orderBookEquals(orderBook,{b2,b1},{}));
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n1),150);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n2),0);
+}
+
+//bigger first, earliest first among equal sizes, whatever happened to the orders
+static bool sizeTimeSorted(const PriceNode* level) {
+	int n = 0;
+	for(const OrderSlot* slot = level->getQueue().front(); slot != NULL; slot = slot->next, ++n) {
+		const Order* next = slot->next != NULL ? slot->next->order : NULL;
+		if(next != NULL && (next->quantity > slot->order->quantity ||
+			(next->quantity == slot->order->quantity && next->time < slot->order->time)))
+			return false;
+	}
+	return n == level->getOrderCount();
+}
+
+BOOST_AUTO_TEST_CASE(TestSizeTimeDeepLevel) {
+	MatchingEngine me(SIZE_TIME);
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	OrderBook* book = me.bookFor(DEFAULT_SYMBOL_ID);
+	uint64_t seed = 7;
+	//a few sizes only, so many orders share one
+	for(int i = 1; i <= 2000; ++i) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		int pick = (seed >> 33) % 10, qty = 1 + (seed >> 40) % 8;
+		OrderId id = 1 + (seed >> 20) % i;
+		if(pick < 6)
+			me.processOrder(new Order(i,n1,100,qty * 10,i,true));
+		else if(pick < 8)
+			book->reduce(id, qty);
+		else if(pick < 9)
+			book->cancel(id);
+		else
+			me.processOrder(new Order(i,n2,100,qty * 3,i,false));
+		const PriceNode* level = book->getBids()->find(100);
+		if(level != NULL && !sizeTimeSorted(level)) {
+			BOOST_ERROR("level out of size-time order after message " << i);
+			break;
+		}
+	}
+	BOOST_CHECK(book->getBids()->find(100)->getOrderCount() > 100);
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelById) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	Order* b1 = new Order(1,n1,100,100,1,true);
+	Order* b2 = new Order(2,n2,100,200,2,true);
+	Order* s1 = new Order(3,n3,200,300,3,false);
+	me.processOrder(b1);
+	me.processOrder(b2);
+	me.processOrder(s1);
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+
+	BOOST_CHECK(orderBook->cancel(1));
+	BOOST_CHECK(!orderBook->cancel(1));
+	BOOST_CHECK(orderBook->findOrder(1) == NULL);
+	BOOST_CHECK(orderBookEquals(orderBook,{b2},{s1}));
+	//last order of a level takes the level with it
+	BOOST_CHECK(orderBook->cancel(3));
+	BOOST_CHECK(orderBook->getAsks()->empty());
+	BOOST_CHECK(!orderBook->cancel(42));
+}
+
+BOOST_AUTO_TEST_CASE(TestReduceKeepsPriority) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	Order* b1 = new Order(1,n1,100,100,1,true);
+	Order* b2 = new Order(2,n2,100,200,2,true);
+	me.processOrder(b1);
+	me.processOrder(b2);
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+
+	BOOST_CHECK(orderBook->reduce(1,60));
+	BOOST_CHECK(orderBook->replace(2,100,150));
+	BOOST_CHECK(orderBookEquals(orderBook,{b1,b2},{}));
+	BOOST_CHECK_EQUAL(b1->quantity,40);
+	BOOST_CHECK_EQUAL(b2->quantity,150);
+
+	Order* s1 = new Order(3,n3,100,50,3,false);
+	me.processOrder(s1);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n1),40);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n2),10);
+	BOOST_CHECK(orderBookEquals(orderBook,{b2},{}));
+}
+
+BOOST_AUTO_TEST_CASE(TestReplaceLosesPriorityAndMatches) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	Order* b1 = new Order(1,n1,100,100,1,true);
+	Order* b2 = new Order(2,n2,100,200,2,true);
+	Order* s1 = new Order(3,n3,120,50,3,false);
+	me.processOrder(b1);
+	me.processOrder(b2);
+	me.processOrder(s1);
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+
+	//a size increase goes to the back of the level
+	BOOST_CHECK(orderBook->replace(1,100,120));
+	BOOST_CHECK(orderBookEquals(orderBook,{b2,b1},{s1}));
+
+	//repricing through the ask trades and posts the rest
+	BOOST_CHECK(orderBook->replace(2,120,80));
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n2),50);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n3),-50);
+	BOOST_CHECK(orderBookEquals(orderBook,{b2,b1},{}));
+	BOOST_CHECK_EQUAL(b2->quantity,30);
+	BOOST_CHECK(!orderBook->replace(3,100,10));
+}
+
+BOOST_AUTO_TEST_CASE(TestArrayLadderScan) {
+	//levels in three different bitmap words
+	ArrayLadder bids(true, 1000, 256), asks(false, 1000, 256);
+	PriceNode n1(1005), n2(1070), n3(1200);
+	PriceNode* nodes[] = { &n1, &n2, &n3 };
+	for(PriceNode* node : nodes) {
+		bids.insert(node->getPrice(), node);
+		asks.insert(node->getPrice(), node);
+	}
+	BOOST_CHECK_EQUAL(bids.best(), &n3);
+	BOOST_CHECK_EQUAL(bids.next(1200), &n2);
+	BOOST_CHECK_EQUAL(bids.next(1070), &n1);
+	BOOST_CHECK(bids.next(1005) == NULL);
+	BOOST_CHECK_EQUAL(asks.best(), &n1);
+	BOOST_CHECK_EQUAL(asks.next(1005), &n2);
+	BOOST_CHECK_EQUAL(asks.next(1070), &n3);
+	BOOST_CHECK(asks.next(1200) == NULL);
+
+	bids.erase(1200);
+	asks.erase(1005);
+	BOOST_CHECK_EQUAL(bids.best(), &n2);
+	BOOST_CHECK_EQUAL(asks.best(), &n2);
+	BOOST_CHECK_EQUAL(bids.size(), 2);
+	BOOST_CHECK(!bids.accepts(999));
+	BOOST_CHECK(!bids.accepts(1256));
+	BOOST_CHECK(bids.find(1070) == &n2 && bids.find(1071) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(TestArrayLadderMultiplePriceLevelMatch) {
+	MatchingEngine me(BookConfig(SIZE_TIME, ARRAY_LADDER, 7000, 1000));
+	string n1 = "Mal", n2 = "Kaylee", n3 = "Tom", n4 = "Kate", n5 = "Rob", n6 = "Bill";
+	me.init( {n1, n2, n3, n4, n5, n6 } );
+
+	Order* b1 = new Order( 70000001, n1, 7311, 100, 100001, true );
+	Order* b2 = new Order( 70000002, n2, 7322, 200, 100002, true );
+	Order* b3 = new Order( 70000003, n3, 7322, 300, 100003, true );
+	Order* b4 = new Order( 70000004, n4, 7323, 400, 100004, true );
+	Order* s1 = new Order( 70000005, n5, 7441, 200, 100005, false );
+	Order* s2 = new Order( 70000006, n6, 7320, 900, 100006, false );
+	me.processOrder( b1 );
+	me.processOrder( b2 );
+	me.processOrder( b3 );
+	me.processOrder( b4 );
+	me.processOrder( s1 );
+	me.processOrder( s2 );
+
+	OrderBook* orderBook = const_cast< OrderBook* >( me.getOrderBook() );
+	BOOST_CHECK( orderBookEquals( orderBook, { b1 }, { s1 } ) );
+	BOOST_CHECK_EQUAL( orderBook->getTraderExposure( n4 ), 400 );
+	BOOST_CHECK_EQUAL( orderBook->getTraderExposure( n6 ), -900 );
+
+	//outside the ladder range the order cannot rest
+	Order* b5 = new Order( 70000007, n1, 8000, 100, 100007, true );
+	BOOST_CHECK( !orderBook->add( b5 ) );
+	delete b5;
+	BOOST_CHECK( orderBookEquals( orderBook, { b1 }, { s1 } ) );
+}
+
+BOOST_AUTO_TEST_CASE(TestInternedTraders) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	TraderId t1 = traderTable().intern(n1);
+	BOOST_CHECK_EQUAL(traderTable().intern(n1), t1);
+	BOOST_CHECK_EQUAL(traderTable().name(t1), n1);
+	BOOST_CHECK(traderTable().find("NeverSeen") == NO_ID);
+
+	//both constructors give the same record
+	Order byName(1,n1,100,10,1,true);
+	Order byId(1,t1,100,10,1,true);
+	BOOST_CHECK(byName == byId);
+	BOOST_CHECK(byName.isBuy());
+
+	me.processOrder(new Order(byId));
+	me.processOrder(new Order(2,n2,100,4,2,false));
+	OrderBook* orderBook = const_cast<OrderBook*>(me.getOrderBook());
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n1),4);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(n2),-4);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure("NeverSeen"),0);
+
+	//only registered traders are booked, not the ids the account grew past
+	string unbooked = "Unbooked", late = "Late";
+	TraderId u = traderTable().intern(unbooked);
+	orderBook->bookTradeForTrader(traderTable().intern(late));
+	BOOST_CHECK(!orderBook->isBooked(u));
+	me.processOrder(new Order(3,unbooked,101,5,3,false));
+	me.processOrder(new Order(4,late,101,5,4,true));
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(unbooked),0);
+	BOOST_CHECK_EQUAL(orderBook->getTraderExposure(late),5);
+
+	//the printed book shows prices in currency units, as the input had them
+	ostringstream text;
+	text << Order(5,n1,50025,10,5,true) << " " << Order(6,n1,50000,10,6,true);
+	BOOST_CHECK_EQUAL(text.str(), n1 + "_500.25_10_5_1 " + n1 + "_500_10_6_1");
+}
+
+BOOST_AUTO_TEST_CASE(TestPerSymbolBooks) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	BOOST_CHECK(me.addInstrument("ACME", BookConfig(PRICE_TIME, ARRAY_LADDER, 0, 1024)));
+	BOOST_CHECK(!me.addInstrument("ACME", BookConfig()));
+	SymbolId acme = symbolTable().find("ACME");
+	SymbolId wdgt = symbolTable().intern("WDGT");
+	BOOST_CHECK(me.getOrderBook(wdgt) == NULL);
+	BOOST_CHECK_EQUAL(me.getBookCount(), 2u);
+
+	//crossing prices on different symbols never match
+	Order* b1 = new Order(1,n1,100,10,1,true,acme);
+	Order* s1 = new Order(2,n2,90,10,2,false,wdgt);
+	Order* s2 = new Order(3,n2,100,4,3,false,acme);
+	me.processOrder(b1);
+	me.processOrder(s1);
+	BOOST_CHECK_EQUAL(me.getBookCount(), 3u);
+	BOOST_CHECK(orderBookEquals(const_cast<OrderBook*>(me.getOrderBook(acme)), {b1}, {}));
+	BOOST_CHECK(orderBookEquals(const_cast<OrderBook*>(me.getOrderBook(wdgt)), {}, {s1}));
+	BOOST_CHECK(me.getOrderBook()->getBids()->empty());
+
+	me.processOrder(s2);
+	BOOST_CHECK_EQUAL(b1->quantity, 6);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n1), 4);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), -4);
+
+	//cancel only looks in the book of the given symbol
+	BOOST_CHECK(!me.cancelOrder(2, acme));
+	BOOST_CHECK(me.cancelOrder(2, wdgt));
+	BOOST_CHECK(me.getOrderBook(wdgt)->getAsks()->empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestExecutionEvents) {
+	MatchingEngine me(BookConfig(PRICE_TIME, ARRAY_LADDER, 0, 1000));
+	EventBuffer events(4);
+	me.setEventBuffer(&events);
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit";
+	me.init({n1,n2,n3});
+	TraderId t1 = traderTable().find(n1), t2 = traderTable().find(n2), t3 = traderTable().find(n3);
+
+	me.processOrder(new Order(1,n1,100,50,1,false));
+	BOOST_REQUIRE_EQUAL(events.size(), 2u);
+	BOOST_CHECK_EQUAL(events[0].type, EVENT_ACCEPTED);
+	BOOST_CHECK_EQUAL(events[1].type, EVENT_RESTED);
+	BOOST_CHECK_EQUAL(events[1].leaves, 50);
+	events.clear();
+	me.processOrder(new Order(2,n2,101,30,2,false));
+	events.clear();
+
+	//takes all of order 1 and part of order 2, the rest rests
+	me.processOrder(new Order(3,n3,101,100,3,true));
+	int expected[] = { EVENT_ACCEPTED, EVENT_TRADE, EVENT_DONE, EVENT_TRADE, EVENT_DONE,
+		EVENT_PARTIAL_FILL, EVENT_RESTED };
+	BOOST_REQUIRE_EQUAL(events.size(), 7u);
+	for(size_t i = 0; i < events.size(); ++i)
+		BOOST_CHECK_EQUAL(events[i].type, expected[i]);
+	//the buffer grew past its reserve
+	BOOST_CHECK(events.capacity() >= 7u);
+
+	const ExecEvent& first = events[1];
+	BOOST_CHECK_EQUAL(first.id, 3);
+	BOOST_CHECK_EQUAL(first.contraId, 1);
+	BOOST_CHECK_EQUAL(first.trader, t3);
+	BOOST_CHECK_EQUAL(first.contraTrader, t1);
+	BOOST_CHECK_EQUAL(first.price, 100);
+	BOOST_CHECK_EQUAL(first.quantity, 50);
+	BOOST_CHECK_EQUAL(first.leaves, 50);
+	BOOST_CHECK(first.flags & ORDER_BUY);
+	BOOST_CHECK_EQUAL(events[2].id, 1);
+	BOOST_CHECK_EQUAL(events[2].reason, DONE_FILLED);
+	BOOST_CHECK_EQUAL(events[3].contraTrader, t2);
+	BOOST_CHECK_EQUAL(events[3].price, 101);
+	BOOST_CHECK_EQUAL(events[5].id, 3);
+	BOOST_CHECK_EQUAL(events[5].leaves, 20);
+	BOOST_CHECK_EQUAL(events[6].leaves, 20);
+	events.clear();
+
+	BOOST_CHECK(me.cancelOrder(3));
+	BOOST_REQUIRE_EQUAL(events.size(), 1u);
+	BOOST_CHECK_EQUAL(events[0].type, EVENT_DONE);
+	BOOST_CHECK_EQUAL(events[0].reason, DONE_CANCELLED);
+	BOOST_CHECK_EQUAL(events[0].quantity, 20);
+	events.clear();
+
+	//out of the ladder range
+	me.processOrder(new Order(4,n1,5000,10,4,true));
+	BOOST_REQUIRE_EQUAL(events.size(), 2u);
+	BOOST_CHECK_EQUAL(events[1].reason, DONE_DROPPED);
+}
+
+BOOST_AUTO_TEST_CASE(TestLevelAggregates) {
+	MatchingEngine me(SIZE_TIME);
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	me.processOrder(new Order(1,n1,100,50,1,true));
+	me.processOrder(new Order(2,n1,100,30,2,true));
+	me.processOrder(new Order(3,n1,99,20,3,true));
+	me.processOrder(new Order(4,n2,102,40,4,false));
+	OrderBook* book = const_cast<OrderBook*>(me.getOrderBook());
+	const PriceNode* top = book->getBids()->best();
+	BOOST_CHECK_EQUAL(top->getQuantity(), 80);
+	BOOST_CHECK_EQUAL(top->getOrderCount(), 2);
+
+	//partial fill, reduce and cancel all move the aggregate
+	me.processOrder(new Order(5,n2,100,60,5,false));
+	BOOST_CHECK_EQUAL(top->getQuantity(), 20);
+	BOOST_CHECK_EQUAL(top->getOrderCount(), 1);
+	uint64_t version = book->getVersion();
+	BOOST_CHECK(book->reduce(2, 5));
+	BOOST_CHECK_EQUAL(top->getQuantity(), 15);
+	BOOST_CHECK(book->getVersion() != version);
+	BOOST_CHECK(book->replace(3, 99, 50));
+	BOOST_CHECK_EQUAL(book->getBids()->find(99)->getQuantity(), 50);
+
+	vector<DepthLevel> depth;
+	book->getDepth(true, 1, depth);
+	BOOST_REQUIRE_EQUAL(depth.size(), 1u);
+	BOOST_CHECK_EQUAL(depth[0].price, 100);
+	BOOST_CHECK_EQUAL(depth[0].quantity, 15);
+	book->getDepth(true, 0, depth);
+	BOOST_REQUIRE_EQUAL(depth.size(), 2u);
+	BOOST_CHECK_EQUAL(depth[1].price, 99);
+	BOOST_CHECK_EQUAL(depth[1].orders, 1);
+	book->getDepth(false, 5, depth);
+	BOOST_REQUIRE_EQUAL(depth.size(), 1u);
+	BOOST_CHECK_EQUAL(depth[0].quantity, 40);
+	BOOST_CHECK(me.cancelOrder(2));
+	BOOST_CHECK(book->getBids()->find(100) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(TestTopOfBookQueries) {
+	BookConfig configs[] = { BookConfig(), BookConfig(PRICE_TIME, ARRAY_LADDER, 0, 1000) };
+	for(const BookConfig& config : configs) {
+		MatchingEngine me(config);
+		string n1 = "Tree", n2 = "Plant";
+		me.init({n1,n2});
+		const OrderBook* book = me.getOrderBook();
+		BOOST_CHECK_EQUAL(book->getBestBid(), INAN);
+		BOOST_CHECK_EQUAL(book->getSpread(), INAN);
+		me.processOrder(new Order(1,n1,99,10,1,true));
+		me.processOrder(new Order(2,n1,100,20,2,true));
+		me.processOrder(new Order(3,n1,98,30,3,true));
+		me.processOrder(new Order(4,n2,103,15,4,false));
+		me.processOrder(new Order(5,n2,102,25,5,false));
+		BOOST_CHECK_EQUAL(book->getBestBid(), 100);
+		BOOST_CHECK_EQUAL(book->getBestAsk(), 102);
+		BOOST_CHECK_EQUAL(book->getSpread(), 2);
+		BOOST_CHECK_EQUAL(book->quantityAt(true, 99), 10);
+		BOOST_CHECK_EQUAL(book->quantityAt(true, 101), 0);
+
+		BOOST_CHECK_EQUAL(book->quantityAvailableUpTo(true, 99), 30);
+		BOOST_CHECK_EQUAL(book->quantityAvailableUpTo(true, 0), 60);
+		BOOST_CHECK_EQUAL(book->quantityAvailableUpTo(false, 102), 25);
+		BOOST_CHECK_EQUAL(book->quantityAvailableUpTo(false, 101), 0);
+		BOOST_CHECK(book->wouldFill(true, 103, 40));
+		BOOST_CHECK(!book->wouldFill(true, 103, 41));
+		BOOST_CHECK(!book->wouldFill(false, 100, 21));
+
+		//sweeping two levels moves the cached best to the next one
+		me.processOrder(new Order(6,n2,98,35,6,false));
+		BOOST_CHECK_EQUAL(book->getBestBid(), 98);
+		BOOST_CHECK_EQUAL(book->quantityAt(true, 98), 25);
+		BOOST_CHECK(me.cancelOrder(5));
+		BOOST_CHECK_EQUAL(book->getBestAsk(), 103);
+		BOOST_CHECK(me.cancelOrder(4));
+		BOOST_CHECK_EQUAL(book->getBestAsk(), INAN);
+		BOOST_CHECK_EQUAL(book->getBestLevel(true), book->getBids()->best());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestTimeInForce) {
+	MatchingEngine me;
+	EventBuffer events;
+	me.setEventBuffer(&events);
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	const OrderBook* book = me.getOrderBook();
+	me.processOrder(new Order(1,n1,100,10,1,false));
+	me.processOrder(new Order(2,n1,101,20,2,false));
+	me.processOrder(new Order(3,n1,105,30,3,false));
+
+	//IOC takes what it can up to its limit, the rest expires
+	Order* ioc = new Order(4,n2,101,50,4,true);
+	ioc->flags |= ORDER_IOC;
+	events.clear();
+	BOOST_CHECK_EQUAL(me.processOrder(ioc), 20);
+	BOOST_CHECK(book->getBids()->empty());
+	BOOST_CHECK_EQUAL(events[events.size() - 1].type, EVENT_DONE);
+	BOOST_CHECK_EQUAL(events[events.size() - 1].reason, DONE_EXPIRED);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), 30);
+
+	//a FOK that cannot fill leaves the book untouched
+	uint64_t version = book->getVersion();
+	Order* fok = new Order(5,n2,105,31,5,true);
+	fok->flags |= ORDER_FOK;
+	events.clear();
+	BOOST_CHECK_EQUAL(me.processOrder(fok), 31);
+	BOOST_CHECK_EQUAL(book->getVersion(), version);
+	BOOST_REQUIRE_EQUAL(events.size(), 2u);
+	BOOST_CHECK_EQUAL(events[1].reason, DONE_EXPIRED);
+	fok = new Order(6,n2,105,30,6,true);
+	fok->flags |= ORDER_FOK;
+	BOOST_CHECK_EQUAL(me.processOrder(fok), 0);
+	BOOST_CHECK(book->getAsks()->empty());
+
+	//market orders ignore their price and never rest
+	me.processOrder(new Order(7,n1,90,10,7,true));
+	me.processOrder(new Order(8,n1,80,10,8,true));
+	Order* market = new Order(9,n2,0,15,9,false);
+	market->flags |= ORDER_MARKET;
+	BOOST_CHECK_EQUAL(me.processOrder(market), 0);
+	BOOST_CHECK_EQUAL(book->getBestBid(), 80);
+	market = new Order(10,n2,0,15,10,false);
+	market->flags |= ORDER_MARKET | ORDER_FOK;
+	BOOST_CHECK_EQUAL(me.processOrder(market), 15);
+	market = new Order(11,n2,0,15,11,false);
+	market->flags |= ORDER_MARKET;
+	BOOST_CHECK_EQUAL(me.processOrder(market), 10);
+	BOOST_CHECK(book->getBids()->empty());
+	BOOST_CHECK(book->getAsks()->empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestIcebergAndHidden) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	const OrderBook* book = me.getOrderBook();
+	me.processOrder(new Order(1,n1,100,100,1,false), 20);
+	me.processOrder(new Order(2,n1,100,30,2,false));
+	const PriceNode* level = book->getAsks()->find(100);
+	BOOST_CHECK_EQUAL(level->getQuantity(), 130);
+	BOOST_CHECK_EQUAL(level->getVisibleQuantity(), 50);
+	BOOST_CHECK_EQUAL(book->findOrder(1)->quantity, 20);
+	vector<DepthLevel> depth;
+	book->getDepth(false, 0, depth);
+	BOOST_REQUIRE_EQUAL(depth.size(), 1u);
+	BOOST_CHECK_EQUAL(depth[0].quantity, 50);
+
+	//the shown slice fills, the next one goes behind order 2
+	me.processOrder(new Order(3,n2,100,25,3,true));
+	BOOST_CHECK_EQUAL(level->getQueue().front()->order->id, 2);
+	BOOST_CHECK_EQUAL(level->getQueue().back()->order->id, 1);
+	BOOST_CHECK_EQUAL(book->findOrder(1)->quantity, 20);
+	BOOST_CHECK_EQUAL(level->getQuantity(), 105);
+	BOOST_CHECK_EQUAL(level->getVisibleQuantity(), 45);
+	//hidden quantity still matches, through several slices
+	BOOST_CHECK(book->wouldFill(true, 100, 105));
+	BOOST_CHECK_EQUAL(me.processOrder(new Order(4,n2,100,60,4,true)), 0);
+	BOOST_CHECK_EQUAL(book->findOrder(1)->quantity, 5);
+	BOOST_CHECK_EQUAL(level->getQuantity(), 45);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), 85);
+
+	//a reduce takes the reserve first
+	OrderBook* mutableBook = const_cast<OrderBook*>(book);
+	BOOST_CHECK(mutableBook->reduce(1, 30));
+	BOOST_CHECK_EQUAL(book->findOrder(1)->quantity, 5);
+	BOOST_CHECK_EQUAL(level->getQuantity(), 15);
+	BOOST_CHECK_EQUAL(level->getVisibleQuantity(), 5);
+
+	//a hidden order rests and matches but never shows
+	Order* hidden = new Order(5,n2,99,50,5,true);
+	hidden->flags |= ORDER_HIDDEN;
+	me.processOrder(hidden);
+	BOOST_CHECK_EQUAL(book->getBestBid(), 99);
+	book->getDepth(true, 0, depth);
+	BOOST_CHECK(depth.empty());
+	BOOST_CHECK_EQUAL(book->quantityAvailableUpTo(true, 99), 50);
+	me.processOrder(new Order(6,n1,99,10,6,false));
+	BOOST_CHECK_EQUAL(book->getBids()->find(99)->getQuantity(), 40);
+	BOOST_CHECK_EQUAL(book->getBids()->find(99)->getVisibleOrderCount(), 0);
+
+	//the peak and the reserve survive a snapshot
+	string path = "/tmp/matching_iceberg_" + to_string(getpid());
+	BOOST_REQUIRE(me.saveSnapshot(path));
+	MatchingEngine restored;
+	BOOST_REQUIRE(restored.loadSnapshot(path));
+	unlink(path.c_str());
+	BOOST_CHECK(sameBook(book, restored.getOrderBook()));
+	const PriceNode* copy = restored.getOrderBook()->getAsks()->find(100);
+	BOOST_CHECK_EQUAL(copy->getQuantity(), 15);
+	BOOST_CHECK_EQUAL(copy->getVisibleQuantity(), 5);
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getBids()->find(99)->getVisibleQuantity(), 0);
+
+	//a hidden iceberg stays hidden across its refills
+	MatchingEngine other;
+	other.init({n1,n2});
+	const OrderBook* otherBook = other.getOrderBook();
+	Order* hiddenIceberg = new Order(1,n1,100,20,1,false);
+	hiddenIceberg->flags |= ORDER_HIDDEN;
+	other.processOrder(hiddenIceberg, 5);
+	other.processOrder(new Order(2,n1,100,3,2,false));
+	//5 from the iceberg, which refills behind order 2, 3 from order 2, 4 from the refill
+	BOOST_CHECK_EQUAL(other.processOrder(new Order(3,n2,100,12,3,true)), 0);
+	const PriceNode* hiddenLevel = otherBook->getAsks()->find(100);
+	BOOST_CHECK_EQUAL(hiddenLevel->getQuantity(), 11);
+	BOOST_CHECK_EQUAL(hiddenLevel->getVisibleQuantity(), 0);
+	otherBook->getDepth(false, 0, depth);
+	BOOST_CHECK(depth.empty());
+	BOOST_CHECK_EQUAL(other.processOrder(new Order(4,n2,100,11,4,true)), 0);
+	BOOST_CHECK(otherBook->getAsks()->empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestStopOrders) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	const OrderBook* book = me.getOrderBook();
+	me.processOrder(new Order(1,n1,100,10,1,false));
+	me.processOrder(new Order(2,n1,101,10,2,false));
+	me.processOrder(new Order(3,n1,102,10,3,false));
+
+	Order* stop = new Order(10,n2,0,5,10,true);
+	stop->flags |= ORDER_MARKET;
+	BOOST_CHECK_EQUAL(me.processStop(stop, 101), 5);
+	BOOST_CHECK_EQUAL(me.processStop(new Order(11,n2,101,20,11,true), 101), 20);
+	BOOST_CHECK_EQUAL(me.processStop(new Order(12,n2,90,5,12,false), 95), 5);
+	BOOST_CHECK_EQUAL(book->getStopCount(), 3u);
+	BOOST_CHECK(book->getBids()->empty());
+
+	//a trade below the trigger fires nothing
+	me.processOrder(new Order(4,n2,100,10,4,true));
+	BOOST_CHECK_EQUAL(book->getStopCount(), 3u);
+	BOOST_CHECK_EQUAL(book->getLastTradePrice(), 100);
+
+	//a print at 101 fires both buy stops, in arrival order : the stop takes
+	//the rest of 101, the stop-limit finds nothing at 101 and rests
+	me.processOrder(new Order(5,n2,101,5,5,true));
+	BOOST_CHECK_EQUAL(book->getStopCount(), 1u);
+	BOOST_CHECK_EQUAL(book->getBestAsk(), 102);
+	BOOST_CHECK_EQUAL(book->getBestBid(), 101);
+	BOOST_CHECK_EQUAL(book->findOrder(11)->quantity, 20);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), 20);
+
+	//the stops survive a snapshot with the last trade price
+	string path = "/tmp/matching_stops_" + to_string(getpid());
+	BOOST_REQUIRE(me.saveSnapshot(path));
+	MatchingEngine restored;
+	BOOST_REQUIRE(restored.loadSnapshot(path));
+	unlink(path.c_str());
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getStopCount(), 1u);
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getLastTradePrice(), 101);
+
+	BOOST_CHECK(me.cancelOrder(12));
+	BOOST_CHECK_EQUAL(book->getStopCount(), 0u);
+	BOOST_CHECK(!me.cancelOrder(12));
+
+	//already through its trigger : executes at once
+	stop = new Order(13,n1,0,20,13,false);
+	stop->flags |= ORDER_MARKET;
+	BOOST_CHECK_EQUAL(me.processStop(stop, 101), 0);
+	BOOST_CHECK(book->getBids()->empty());
+	//the restored sell stop fires on the print at 95 and rests at its limit
+	restored.processOrder(new Order(6,n1,95,5,6,true));
+	restored.processOrder(new Order(7,n1,95,25,7,false));
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getStopCount(), 0u);
+	BOOST_CHECK(restored.getOrderBook()->getBids()->empty());
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getAsks()->find(90)->getQuantity(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(TestBatchSubmission) {
+	FlowConfig flowConfig;
+	flowConfig.seed = 5;
+	OrderFlow flow(flowConfig);
+	MatchingEngine single, batched;
+	single.init({"flow0", "Tree"});
+	batched.init({"flow0", "Tree"});
+	EventBuffer singleEvents, batchEvents;
+	single.setEventBuffer(&singleEvents);
+	batched.setEventBuffer(&batchEvents);
+
+	vector<LogRecord> records;
+	FlowMessage message;
+	for(int i = 0; i < 3000; ++i) {
+		flow.next(message);
+		if(message.type == LOG_CANCEL) {
+			single.cancelOrder(message.order.id);
+			LogRecord record = { LOG_CANCEL, 0, DEFAULT_SYMBOL_ID, 0, message.order.id, 0, 0, 0 };
+			records.push_back(record);
+		}
+		else {
+			single.processOrder(single.bookFor(DEFAULT_SYMBOL_ID)->newOrder(message.order));
+			records.push_back(newRecord(message.order));
+		}
+	}
+	//an iceberg and a stop, each a record ahead of its LOG_NEW
+	Order iceberg(100000, traderTable().intern("Tree"), flowConfig.mid - 5, 300, 100000, true);
+	single.processOrder(single.bookFor(DEFAULT_SYMBOL_ID)->newOrder(iceberg), 50);
+	LogRecord peak = { LOG_PEAK, 0, DEFAULT_SYMBOL_ID, 0, iceberg.id, 0, 0, 50 };
+	records.push_back(peak);
+	records.push_back(newRecord(iceberg));
+	Order stop(100001, iceberg.trader, flowConfig.mid + 20, 40, 100001, true);
+	single.processStop(single.bookFor(DEFAULT_SYMBOL_ID)->newOrder(stop), flowConfig.mid + 10);
+	LogRecord trigger = { LOG_STOP, 0, DEFAULT_SYMBOL_ID, 0, stop.id, 0, flowConfig.mid + 10, 0 };
+	records.push_back(trigger);
+	records.push_back(newRecord(stop));
+
+	size_t nMessages = 0;
+	for(size_t i = 0; i < records.size(); i += 64)
+		nMessages += batched.processBatch(records.data() + i, min((size_t)64, records.size() - i));
+	BOOST_CHECK_EQUAL(nMessages, 3002u);
+	BOOST_CHECK_EQUAL(batched.getSequence(), single.getSequence());
+	BOOST_CHECK(sameBook(batched.getOrderBook(), single.getOrderBook()));
+	BOOST_CHECK_EQUAL(batched.getOrderBook()->getStopCount(), single.getOrderBook()->getStopCount());
+	BOOST_CHECK_EQUAL(batched.getTraderExposure("flow0"), single.getTraderExposure("flow0"));
+	BOOST_CHECK_EQUAL(batched.getTraderExposure("Tree"), single.getTraderExposure("Tree"));
+	//every event of every batch, in the same order
+	BOOST_REQUIRE_EQUAL(batchEvents.size(), singleEvents.size());
+	for(size_t i = 0; i < batchEvents.size(); ++i) {
+		BOOST_CHECK_EQUAL(batchEvents[i].type, singleEvents[i].type);
+		BOOST_CHECK_EQUAL(batchEvents[i].id, singleEvents[i].id);
+		BOOST_CHECK_EQUAL(batchEvents[i].contraId, singleEvents[i].contraId);
+		BOOST_CHECK_EQUAL(batchEvents[i].quantity, singleEvents[i].quantity);
+		BOOST_CHECK_EQUAL(batchEvents[i].leaves, singleEvents[i].leaves);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataAllocation) {
+	BookConfig config(PRO_RATA);
+	config.minAllocation = 3;
+	MatchingEngine me(config);
+	string n1 = "Tree", n2 = "Plant", n3 = "Rabbit", n4 = "Fox";
+	me.init({n1,n2,n3,n4});
+	const OrderBook* book = me.getOrderBook();
+	me.processOrder(new Order(1,n1,100,10,1,false));
+	me.processOrder(new Order(2,n2,100,30,2,false));
+	me.processOrder(new Order(3,n3,100,60,3,false));
+
+	//shares of 25 out of 100 : 2.5 (below the minimum), 7.5 and 15.
+	//the 3 lots left go to the oldest order
+	me.processOrder(new Order(4,n4,100,25,4,true));
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n1), -3);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), -7);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n3), -15);
+	BOOST_CHECK_EQUAL(book->findOrder(1)->quantity, 7);
+	BOOST_CHECK_EQUAL(book->findOrder(2)->quantity, 23);
+	BOOST_CHECK_EQUAL(book->findOrder(3)->quantity, 45);
+	BOOST_CHECK_EQUAL(book->quantityAt(false, 100), 75);
+	//the queue stays in time order
+	BOOST_CHECK_EQUAL(book->getAsks()->best()->getQueue().front()->order->id, 1);
+
+	//more than the level : everything fills, then it rests
+	me.processOrder(new Order(5,n4,100,80,5,true));
+	BOOST_CHECK(book->getAsks()->empty());
+	BOOST_CHECK_EQUAL(book->getBestBid(), 100);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n4), 100);
+
+	//hybrid : the top order fills first, its 10 are gone, then 15 of the 90 left
+	MatchingEngine hybrid(PRO_RATA_TOP);
+	hybrid.init({n1,n2,n3,n4});
+	hybrid.processOrder(new Order(1,n1,100,10,1,false));
+	hybrid.processOrder(new Order(2,n2,100,30,2,false));
+	Order* iceberg = new Order(3,n3,100,60,3,false);
+	hybrid.processOrder(iceberg, 20);
+	hybrid.processOrder(new Order(4,n4,100,25,4,true));
+	BOOST_CHECK_EQUAL(hybrid.getTraderExposure(n1), -10);
+	BOOST_CHECK_EQUAL(hybrid.getTraderExposure(n2), -5);
+	//the share of the iceberg counts its reserve
+	BOOST_CHECK_EQUAL(hybrid.getTraderExposure(n3), -10);
+	BOOST_CHECK(hybrid.getOrderBook()->findOrder(1) == NULL);
+	BOOST_CHECK_EQUAL(hybrid.getOrderBook()->quantityAt(false, 100), 75);
+	BOOST_CHECK_EQUAL(hybrid.getOrderBook()->getBestLevel(false)->getVisibleQuantity(), 35);
+
+	//the policy and minimum survive a snapshot
+	string path = "/tmp/matching_prorata_" + to_string(getpid());
+	BOOST_REQUIRE(me.saveSnapshot(path));
+	MatchingEngine restored;
+	BOOST_REQUIRE(restored.loadSnapshot(path));
+	unlink(path.c_str());
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getConfig().priority, PRO_RATA);
+	BOOST_CHECK_EQUAL(restored.getOrderBook()->getConfig().minAllocation, 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestCallAuction) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	const OrderBook* book = me.getOrderBook();
+	me.beginAuction();
+	BOOST_CHECK(book->inAuction());
+	BOOST_CHECK_EQUAL(me.processOrder(new Order(1,n1,102,10,1,true)), 10);
+	me.processOrder(new Order(2,n1,101,20,2,true));
+	me.processOrder(new Order(3,n1,99,10,3,true));
+	me.processOrder(new Order(4,n2,98,15,4,false));
+	me.processOrder(new Order(5,n2,100,10,5,false));
+	me.processOrder(new Order(6,n2,103,5,6,false));
+	Order* ioc = new Order(7,n2,98,5,7,false);
+	ioc->flags |= ORDER_IOC;
+	BOOST_CHECK_EQUAL(me.processOrder(ioc), 5);
+	//nothing traded, the book is crossed
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n1), 0);
+	BOOST_CHECK_EQUAL(book->getBestBid(), 102);
+	BOOST_CHECK_EQUAL(book->getBestAsk(), 98);
+	BOOST_CHECK(!IS_VALID(book->getLastTradePrice()));
+
+	//25 trade at 100 and at 101, both leave 5 bought unmatched : buyers are
+	//left over so the higher price wins
+	AuctionResult result;
+	BOOST_REQUIRE(book->findEquilibrium(result));
+	BOOST_CHECK_EQUAL(result.price, 101);
+	BOOST_CHECK_EQUAL(result.volume, 25);
+	BOOST_CHECK_EQUAL(result.surplus, 5);
+
+	//the call phase survives a snapshot
+	string path = "/tmp/matching_auction_" + to_string(getpid());
+	BOOST_REQUIRE(me.saveSnapshot(path));
+	MatchingEngine restored;
+	BOOST_REQUIRE(restored.loadSnapshot(path));
+	unlink(path.c_str());
+	BOOST_CHECK(restored.getOrderBook()->inAuction());
+
+	BOOST_CHECK_EQUAL(me.uncross(), 25);
+	BOOST_CHECK(!book->inAuction());
+	BOOST_CHECK_EQUAL(book->getLastTradePrice(), 101);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n1), 25);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), -25);
+	BOOST_CHECK_EQUAL(book->getBestBid(), 101);
+	BOOST_CHECK_EQUAL(book->findOrder(2)->quantity, 5);
+	BOOST_CHECK_EQUAL(book->getBestAsk(), 103);
+	BOOST_CHECK(!book->findEquilibrium(result));
+
+	//continuous matching again
+	me.processOrder(new Order(8,n2,101,5,8,false));
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n1), 30);
+	BOOST_CHECK_EQUAL(me.getSequence(), 10u);
+
+	//sellers left over take the lowest price
+	MatchingEngine other;
+	other.beginAuction();
+	other.processOrder(new Order(1,n1,100,10,1,true));
+	other.processOrder(new Order(2,n2,99,15,2,false));
+	BOOST_REQUIRE(other.getOrderBook()->findEquilibrium(result));
+	BOOST_CHECK_EQUAL(result.price, 99);
+	BOOST_CHECK_EQUAL(result.surplus, -5);
+	//balanced : nearest the last trade, the lowest without one
+	BOOST_CHECK_EQUAL(other.uncross(), 10);
+	other.processOrder(new Order(3,n1,99,5,3,true));
+	other.processOrder(new Order(4,n2,100,5,4,false));
+	other.processOrder(new Order(5,n1,100,5,5,true));
+	BOOST_CHECK_EQUAL(other.getOrderBook()->getLastTradePrice(), 100);
+	other.beginAuction();
+	other.processOrder(new Order(6,n1,100,10,6,true));
+	other.processOrder(new Order(7,n2,99,10,7,false));
+	BOOST_REQUIRE(other.getOrderBook()->findEquilibrium(result));
+	BOOST_CHECK_EQUAL(result.price, 100);
+	BOOST_CHECK_EQUAL(result.surplus, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRiskGate) {
+	BookConfig config;
+	config.collar = 5;
+	MatchingEngine me(config);
+	EventBuffer events;
+	me.setEventBuffer(&events);
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	RiskLimits limits = { 50, 80, 100, 4500 };
+	me.setRiskLimits(n2, limits);
+	const OrderBook* book = me.getOrderBook();
+	TraderId t2 = traderTable().find(n2);
+	me.processOrder(new Order(1,n1,100,100,1,false));
+
+	//each limit in turn, nothing reaches the book
+	struct { int qty; int price; RejectReason reason; } rejects[] = {
+		{ 60, 90, REJECT_ORDER_QTY },
+		{ 10, 106, REJECT_COLLAR },
+		{ 40, 300, REJECT_COLLAR },
+		{ 46, 100, REJECT_NOTIONAL }
+	};
+	for(size_t i = 0; i < 4; ++i) {
+		events.clear();
+		BOOST_CHECK_EQUAL(me.processOrder(new Order(10 + i,n2,rejects[i].price,rejects[i].qty,10 + i,true)), rejects[i].qty);
+		BOOST_REQUIRE_EQUAL(events.size(), 1u);
+		BOOST_CHECK_EQUAL(events[0].type, EVENT_REJECTED);
+		BOOST_CHECK_EQUAL(events[0].reason, rejects[i].reason);
+	}
+	BOOST_CHECK_EQUAL(book->getBestAsk(), 100);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), 0);
+
+	//within the collar and the limits : 40 fill, then 40 rest
+	me.processOrder(new Order(20,n2,105,40,20,true));
+	me.processOrder(new Order(21,n2,99,40,21,true));
+	BOOST_CHECK_EQUAL(me.getTraderExposure(n2), 40);
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(t2).buy, 40);
+	//40 held + 40 resting + 30 would be long 110
+	events.clear();
+	me.processOrder(new Order(22,n2,98,30,22,true));
+	BOOST_CHECK_EQUAL(events[0].reason, REJECT_POSITION);
+	//50 open + 40 resting is more than 80 open
+	events.clear();
+	me.processOrder(new Order(23,n2,101,45,23,false));
+	BOOST_CHECK_EQUAL(events[0].reason, REJECT_OPEN_QTY);
+
+	//the open totals follow fills, reductions and cancels
+	me.processOrder(new Order(2,n1,99,15,2,false));
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(t2).buy, 25);
+	BOOST_CHECK(me.replaceOrder(21, 99, 20));
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(t2).buy, 20);
+	BOOST_CHECK(me.cancelOrder(21));
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(t2).buy, 0);
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(traderTable().find(n1)).sell, 60);
+	//traders without limits only meet the collar
+	events.clear();
+	me.processOrder(new Order(3,n1,90,500,3,false));
+	BOOST_CHECK_EQUAL(events[0].type, EVENT_ACCEPTED);
+}
+
+//a sells 10 then b sells 10 at 100, then a buys 15 at 100
+BOOST_AUTO_TEST_CASE(TestSelfTradePrevention) {
+	//traded is the volume of the buy, fromB what b sold, openA what a still offers
+	struct { StpMode stp; int unfilled; int bestAsk; int bestBid; int traded; int fromB; int openA; int selfTradeEvents; } modes[] = {
+		{ STP_CANCEL_NEWEST, 15, 100, INAN, 0, 0, 10, 1 },
+		{ STP_CANCEL_OLDEST, 5, INAN, 100, 10, 10, 0, 1 },
+		{ STP_CANCEL_BOTH, 15, 100, INAN, 0, 0, 0, 2 },
+		{ STP_DECREMENT, 10, 100, INAN, 5, 5, 0, 1 },
+		{ STP_NONE, 0, 100, INAN, 15, 5, 0, 0 }
+	};
+	string a = "Tree", b = "Plant";
+	for(size_t i = 0; i < 5; ++i) {
+		BookConfig config;
+		config.stp = modes[i].stp;
+		MatchingEngine me(config);
+		EventBuffer events;
+		me.setEventBuffer(&events);
+		me.init({a,b});
+		me.processOrder(new Order(1,a,100,10,1,false));
+		me.processOrder(new Order(2,b,100,10,2,false));
+		events.clear();
+		BOOST_CHECK_EQUAL(me.processOrder(new Order(3,a,100,15,3,true)), modes[i].unfilled);
+		const OrderBook* book = me.getOrderBook();
+		BOOST_CHECK_EQUAL(book->getBestAsk(), modes[i].bestAsk);
+		BOOST_CHECK_EQUAL(book->getBestBid(), modes[i].bestBid);
+		BOOST_CHECK_EQUAL(me.getTraderExposure(b), -modes[i].fromB);
+		int selfTrades = 0, traded = 0;
+		for(size_t e = 0; e < events.size(); ++e) {
+			if(events[e].type == EVENT_DONE && events[e].reason == DONE_SELF_TRADE)
+				++selfTrades;
+			if(events[e].type == EVENT_TRADE) {
+				traded += events[e].quantity;
+				BOOST_CHECK(events[e].contraTrader != events[e].trader || modes[i].stp == STP_NONE);
+			}
+		}
+		BOOST_CHECK_EQUAL(selfTrades, modes[i].selfTradeEvents);
+		BOOST_CHECK_EQUAL(traded, modes[i].traded);
+		BOOST_CHECK_EQUAL(book->getOpenQuantity(traderTable().find(a)).sell, modes[i].openA);
+	}
+
+	//decrement against a larger resting iceberg : its reserve goes first
+	BookConfig config;
+	config.stp = STP_DECREMENT;
+	MatchingEngine me(config);
+	EventBuffer events;
+	me.setEventBuffer(&events);
+	me.init({a,b});
+	me.processOrder(new Order(1,a,100,20,1,false), 8);
+	events.clear();
+	BOOST_CHECK_EQUAL(me.processOrder(new Order(2,a,101,15,2,true)), 15);
+	const OrderBook* book = me.getOrderBook();
+	vector<DepthLevel> depth;
+	book->getDepth(true, 0, depth);
+	BOOST_CHECK(depth.empty());
+	book->getDepth(false, 0, depth);
+	BOOST_REQUIRE_EQUAL(depth.size(), 1u);
+	BOOST_CHECK_EQUAL(depth[0].quantity, 5);
+	BOOST_CHECK_EQUAL(book->getOpenQuantity(traderTable().find(a)).sell, 5);
+	BOOST_REQUIRE_EQUAL(events.size(), 3u);
+	BOOST_CHECK_EQUAL(events[1].type, EVENT_DECREMENTED);
+	BOOST_CHECK_EQUAL(events[1].id, 1);
+	BOOST_CHECK_EQUAL(events[1].quantity, 15);
+	BOOST_CHECK_EQUAL(events[1].leaves, 5);
+	BOOST_CHECK_EQUAL(events[2].type, EVENT_DONE);
+	BOOST_CHECK_EQUAL(events[2].reason, DONE_SELF_TRADE);
+	BOOST_CHECK_EQUAL(me.getTraderExposure(a), 0);
+
+	//pro-rata shares come from the quantity before the walk, decrement takes
+	//some of it away during the walk
+	BookConfig proRata(PRO_RATA);
+	proRata.stp = STP_DECREMENT;
+	MatchingEngine pr(proRata);
+	pr.setEventBuffer(&events);
+	pr.init({a,b});
+	pr.processOrder(new Order(1,a,100,10,1,false));
+	pr.processOrder(new Order(2,b,100,90,2,false));
+	events.clear();
+	BOOST_CHECK_EQUAL(pr.processOrder(new Order(3,a,100,50,3,true)), 10);
+	BOOST_CHECK_EQUAL(pr.getTraderExposure(b), -40);
+	BOOST_CHECK_EQUAL(pr.getOrderBook()->getBestBid(), INAN);
+	BOOST_CHECK_EQUAL(pr.getOrderBook()->quantityAt(false, 100), 50);
+	BOOST_CHECK_EQUAL(pr.getOrderBook()->getOpenQuantity(traderTable().find(a)).sell, 0);
+	BOOST_REQUIRE(!events.empty());
+	BOOST_CHECK_EQUAL(events[events.size() - 1].type, EVENT_DONE);
+	BOOST_CHECK_EQUAL(events[events.size() - 1].id, 3);
+
+	//fill-or-kill : the trader's own quantity is not there to fill it
+	struct { StpMode stp; PriorityPolicy priority; bool ownFirst; int unfilled; } fok[] = {
+		{ STP_CANCEL_OLDEST, PRICE_TIME, true, 10 },
+		{ STP_CANCEL_OLDEST, PRICE_TIME, false, 10 },
+		{ STP_DECREMENT, PRICE_TIME, false, 10 },
+		{ STP_CANCEL_NEWEST, PRICE_TIME, false, 10 },
+		{ STP_CANCEL_NEWEST, PRO_RATA, false, 10 },
+		{ STP_NONE, PRICE_TIME, true, 0 }
+	};
+	for(size_t i = 0; i < 6; ++i) {
+		BookConfig fokConfig(fok[i].priority);
+		fokConfig.stp = fok[i].stp;
+		MatchingEngine fe(fokConfig);
+		fe.init({a,b});
+		fe.processOrder(new Order(1,fok[i].ownFirst ? a : b,100,5,1,false));
+		fe.processOrder(new Order(2,fok[i].ownFirst ? b : a,100,5,2,false));
+		fe.processOrder(new Order(3,b,101,5,3,false));
+		Order* kill = new Order(4,a,100,10,4,true);
+		kill->flags |= ORDER_FOK;
+		BOOST_CHECK_EQUAL(fe.processOrder(kill), fok[i].unfilled);
+		//killed : nothing traded, the book is as it was
+		if(fok[i].unfilled == 10) {
+			BOOST_CHECK_EQUAL(fe.getTraderExposure(b), 0);
+			BOOST_CHECK_EQUAL(fe.getOrderBook()->quantityAt(false, 100), 10);
+		}
+	}
+	//enough from others ahead of the own quote still fills
+	BookConfig ahead;
+	ahead.stp = STP_CANCEL_NEWEST;
+	MatchingEngine ae(ahead);
+	ae.init({a,b});
+	ae.processOrder(new Order(1,b,100,10,1,false));
+	ae.processOrder(new Order(2,a,100,5,2,false));
+	Order* fill = new Order(3,a,100,10,3,true);
+	fill->flags |= ORDER_FOK;
+	BOOST_CHECK_EQUAL(ae.processOrder(fill), 0);
+	BOOST_CHECK_EQUAL(ae.getTraderExposure(b), -10);
+}
+
+#ifdef MATCHING_STATS
+BOOST_AUTO_TEST_CASE(TestBookStats) {
+	MatchingEngine me;
+	string n1 = "Tree", n2 = "Plant";
+	me.init({n1,n2});
+	me.processOrder(new Order(1,n1,100,10,1,false));
+	me.processOrder(new Order(2,n1,100,10,2,false));
+	me.processOrder(new Order(3,n1,101,10,3,false));
+	me.processOrder(new Order(4,n2,101,25,4,true));
+	me.cancelOrder(3);
+
+	const BookStats& stats = me.getOrderBook()->getStats();
+	BOOST_CHECK_EQUAL(stats.orders, 4u);
+	BOOST_CHECK_EQUAL(stats.cancels, 1u);
+	BOOST_CHECK_EQUAL(stats.fills, 3u);
+	BOOST_CHECK_EQUAL(stats.levelsSwept, 2u);
+	BOOST_CHECK_EQUAL(stats.levelsCreated, 2u);
+	BOOST_CHECK_EQUAL(stats.levelsDestroyed, 2u);
+	BOOST_CHECK_EQUAL(stats.maxQueueDepth, 2u);
+	BOOST_CHECK_EQUAL(stats.addLatency.count(), 3u);
+	BOOST_CHECK_EQUAL(stats.matchLatency.count(), 4u);
+	BOOST_CHECK_EQUAL(stats.cancelLatency.count(), 1u);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
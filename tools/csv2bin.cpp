@@ -0,0 +1,50 @@
+/* csv2bin - converts a CSV order file to the binary order log
+replayed by matching -b */
+
+#include <iostream>
+#include <unistd.h>
+#include "../src/binaryLog.h"
+using namespace std;
+using namespace Matching;
+
+void usage()
+{
+    cout << "csv2bin - CSV orders to binary order log\n" << endl;
+    cout << "Usage: csv2bin -i inputFile -o outputFile [-s symbol]\n" << endl;
+    cout << "Options: " << endl;
+    cout << "  -i, input file in the order.csv format" << endl;
+    cout << "  -o, binary log to write" << endl;
+    cout << "  -s, instrument of the orders without a SYMBOL column. Default DEFAULT" << endl;
+    cout << endl;
+}
+
+int main(int argc, char** argv)
+{
+    string infile, outfile, symbol = "DEFAULT";
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:s:")) != -1) {
+        switch(opt) {
+        case 'i':
+            infile = optarg;
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case 's':
+            symbol = optarg;
+            break;
+        default:
+            usage();
+            return -1;
+        }
+    }
+    if(infile.empty() || outfile.empty()) {
+        usage();
+        return -1;
+    }
+    int n = csvToBinary(infile, outfile, symbol);
+    if(n < 0)
+        return -1;
+    cerr << n << " orders written to " << outfile << endl;
+    return 0;
+}